@@ -37,111 +37,61 @@
 	//////////////////////////////////////////////////////////////////////////
 	FBXMeshNode* FBXScene::GetMeshByName(const char* a_name)
 	{
-		auto oIter = m_meshes.find(a_name);
-		if (oIter != m_meshes.end())
-			return oIter->second;
-		return nullptr;
+		return m_meshes.Find(a_name);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 	FBXLightNode* FBXScene::GetLightByName(const char* a_name)
 	{
-		auto oIter = m_lights.find(a_name);
-		if (oIter != m_lights.end())
-			return oIter->second;
-		return nullptr;
+		return m_lights.Find(a_name);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 	FBXCameraNode* FBXScene::GetCameraByName(const char* a_name)
 	{
-		auto oIter = m_cameras.find(a_name);
-		if (oIter != m_cameras.end())
-			return oIter->second;
-		return nullptr;
+		return m_cameras.Find(a_name);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 	FBXMaterial* FBXScene::GetMaterialByName(const char* a_name)
 	{
-		auto oIter = m_materials.find(a_name);
-		if (oIter != m_materials.end())
-			return oIter->second;
-		return nullptr;
+		return m_materials.Find(a_name);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 	FBXAnimation* FBXScene::GetAnimationByName(const char* a_name)
 	{
-		auto oIter = m_animations.find(a_name);
-		if (oIter != m_animations.end())
-			return oIter->second;
-		return nullptr;
+		return m_animations.Find(a_name);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 	FBXMeshNode* FBXScene::GetMeshByIndex(unsigned int a_index)
 	{
-		FBXMeshNode* mesh = nullptr;
-		auto iter = m_meshes.begin();
-		unsigned int size = m_meshes.size();
-
-		for ( unsigned int i = 0 ; i <= a_index && a_index < size ; ++i, ++iter )
-			mesh = iter->second; 
-
-		return mesh;
+		return m_meshes.Get(a_index);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 	FBXLightNode* FBXScene::GetLightByIndex(unsigned int a_index)
 	{
-		FBXLightNode* light = nullptr;
-		auto iter = m_lights.begin();
-		unsigned int size = m_lights.size();
-
-		for ( unsigned int i = 0 ; i <= a_index && a_index < size ; ++i, ++iter )
-			light = iter->second; 
-
-		return light;
+		return m_lights.Get(a_index);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 	FBXCameraNode* FBXScene::GetCameraByIndex(unsigned int a_index)
 	{
-		FBXCameraNode* camera = nullptr;
-		auto iter = m_cameras.begin();
-		unsigned int size = m_cameras.size();
-
-		for ( unsigned int i = 0 ; i <= a_index && a_index < size ; ++i, ++iter )
-			camera = iter->second; 
-
-		return camera;
+		return m_cameras.Get(a_index);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 	FBXMaterial* FBXScene::GetMaterialByIndex(unsigned int a_index)
 	{
-		FBXMaterial* material = nullptr;
-		auto iter = m_materials.begin();
-		unsigned int size = m_materials.size();
-
-		for ( unsigned int i = 0 ; i <= a_index && a_index < size ; ++i, ++iter )
-			material = iter->second; 
-
-		return material;
+		return m_materials.Get(a_index);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 	FBXAnimation* FBXScene::GetAnimationByIndex(unsigned int a_index)
 	{
-		FBXAnimation* animation = nullptr;
-		auto iter = m_animations.begin();
-		unsigned int size = m_animations.size();
-
-		for ( unsigned int i = 0 ; i <= a_index && a_index < size ; ++i, ++iter )
-			animation = iter->second; 
-
-		return animation;
+		return m_animations.Get(a_index);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
@@ -149,57 +99,32 @@
 	{
 		delete m_root;
 		m_root = nullptr;
-		
-		#ifdef _MSC_VER
 
-		for (std::map<std::string, FBXMaterial*>::iterator l_Iter = m_materials.begin(); l_Iter != m_materials.end(); l_Iter++)
-		{
-			delete l_Iter._Ptr->_Myval.second;
-		}
-		
-		#else
-		
-		for(auto l_Iter : m_materials)
+		for (unsigned int i = 0; i < m_materials.Size(); i++)
 		{
-			delete l_Iter.second;
+			delete m_materials.Get(i);
 		}
-		
-		#endif
 
 		for (unsigned int i = 0; i < m_skeletons.size(); i++)
 		{
 			delete m_skeletons[i];
 		}
-		
-		#ifdef _MSC_VER
 
-		for (std::map<std::string, FBXAnimation*>::iterator l_Iter = m_animations.begin(); l_Iter != m_animations.end(); l_Iter++)
-		{
-			for (unsigned int i = 0 ; i < l_Iter._Ptr->_Myval.second->m_trackCount ; ++i )
-				delete[] l_Iter._Ptr->_Myval.second->m_tracks[i].m_keyframes;
-			delete[] l_Iter._Ptr->_Myval.second->m_tracks;
-			delete l_Iter._Ptr->_Myval.second;
-		}
-		
-		#else 
-		
-		for (auto l_Iter : m_animations)
+		for (unsigned int i = 0; i < m_animations.Size(); i++)
 		{
-			for (unsigned int i = 0 ; i < l_Iter.second->m_trackCount ; ++i )
-				delete[] l_Iter.second->m_tracks[i].m_keyframes;
-			delete[] l_Iter.second->m_tracks;
-			delete l_Iter.second;
-			
+			FBXAnimation* anim = m_animations.Get(i);
+			for (unsigned int j = 0 ; j < anim->m_trackCount ; ++j )
+				delete[] anim->m_tracks[j].m_keyframes;
+			delete[] anim->m_tracks;
+			delete anim;
 		}
-		
-		#endif
 
-		m_meshes.clear();
-		m_lights.clear();
-		m_cameras.clear();
-		m_materials.clear();
+		m_meshes.Clear();
+		m_lights.Clear();
+		m_cameras.Clear();
+		m_materials.Clear();
 		m_skeletons.clear();
-		m_animations.clear();
+		m_animations.Clear();
 	}
 	
 	void FBXScene::GatherBones(void* a_object)
@@ -415,7 +340,7 @@
 					if (strlen(fbxNode->GetName()) > 0)
 						strncpy(node->m_name,fbxNode->GetName(),MAX_PATH-1);
 
-					m_meshes[node->m_name] = (FBXMeshNode*)node;
+					m_meshes.Add(node->m_name, (FBXMeshNode*)node);
 				}
 				break;
 
@@ -430,7 +355,7 @@
 					if (strlen(fbxNode->GetName()) > 0)
 						strncpy(node->m_name,fbxNode->GetName(),MAX_PATH-1);
 
-					m_cameras[node->m_name] = (FBXCameraNode*)node;
+					m_cameras.Add(node->m_name, (FBXCameraNode*)node);
 				}
 				break;
 
@@ -442,7 +367,7 @@
 					if (strlen(fbxNode->GetName()) > 0)
 						strncpy(node->m_name,fbxNode->GetName(),MAX_PATH-1);
 
-					m_lights[node->m_name] = (FBXLightNode*)node;
+					m_lights.Add(node->m_name, (FBXLightNode*)node);
 				}
 				break;
 			}   
@@ -496,10 +421,36 @@
 		FbxMesh* fbxMesh = (FbxMesh*)fbxNode->GetNodeAttribute();
 
 		int i, j, lPolygonCount = fbxMesh->GetPolygonCount();
-		FbxVector4* lControlPoints = fbxMesh->GetControlPoints(); 
+		int lControlPointCount = fbxMesh->GetControlPointsCount();
+
+		// count triangles first so the buffers are only allocated once
+		unsigned int cornerCount = fbxMesh->GetPolygonVertexCount();
+		unsigned int triangleCount = 0;
+		int maxPolygonSize = 0;
+		for (i = 0; i < lPolygonCount; i++)
+		{
+			int lPolygonSize = fbxMesh->GetPolygonSize(i);
+			if (lPolygonSize > 2)
+				triangleCount += lPolygonSize - 2;
+			maxPolygonSize = lPolygonSize > maxPolygonSize ? lPolygonSize : maxPolygonSize;
+		}
+
+		// welding only ever removes verts so the corner count is an upper bound
+		a_mesh->m_vertices.reserve(cornerCount);
+		a_mesh->m_indices.resize(triangleCount * 3);
+		unsigned int* indices = a_mesh->m_indices.data();
+
+		// convert all control points in one pass rather than per corner
+		std::vector<glm::vec4> controlPoints(lControlPointCount, glm::vec4(0,0,0,1));
+		if (lControlPointCount > 0)
+			ConvertDoubles<3>((const double*)fbxMesh->GetControlPoints(), 4, &controlPoints[0].x, 4, lControlPointCount);
 
 		FBXVertex vertex;
-		unsigned int vertexIndex[4] = {};
+		std::vector<unsigned int> vertexIndex(maxPolygonSize);
+
+		// the control point index is bookkeeping only so it is left out of the weld key
+		TVertexWelder<FBXVertex, float> welder(FBXVertex::ControlPointOffset / sizeof(float), m_weldEpsilon);
+		welder.Reserve(fbxMesh->GetPolygonVertexCount());
 		
 		int vertexId = 0;
 		for (i = 0; i < lPolygonCount; i++)
@@ -507,17 +458,14 @@
 			int l;
 			int lPolygonSize = fbxMesh->GetPolygonSize(i);
 
-			for (j = 0; j < lPolygonSize && j < 4 ; j++)
+			for (j = 0; j < lPolygonSize; j++)
 			{
 				int lControlPointIndex = fbxMesh->GetPolygonVertex(i, j);
 
 				vertex.fbxControlPointIndex = lControlPointIndex;
 
 				// POSITION
-				FbxVector4 vPos = lControlPoints[lControlPointIndex];
-				vertex.position.x = (float)vPos[0];
-				vertex.position.y = (float)vPos[1];
-				vertex.position.z = (float)vPos[2];
+				vertex.position = controlPoints[lControlPointIndex];
 				
 				for (l = 0; l < fbxMesh->GetElementVertexColorCount(); l++)
 				{
@@ -709,21 +657,16 @@
 				}
 
 				// add to 
-				vertexIndex[j] = AddVertGetIndex(a_mesh->m_vertices,vertex);
+				vertexIndex[j] = AddVertGetIndex(a_mesh->m_vertices,vertex,welder);
 				vertexId++;
 			}
 
-			// add triangle indices
-			a_mesh->m_indices.push_back(vertexIndex[0]);
-			a_mesh->m_indices.push_back(vertexIndex[1]);
-			a_mesh->m_indices.push_back(vertexIndex[2]);
-
-			// handle quads
-			if (lPolygonSize == 4)
+			// add triangle indices, quads and larger polygons are fanned
+			for (j = 2; j < lPolygonSize; j++)
 			{
-				a_mesh->m_indices.push_back(vertexIndex[0]);
-				a_mesh->m_indices.push_back(vertexIndex[2]);
-				a_mesh->m_indices.push_back(vertexIndex[3]);
+				*indices++ = vertexIndex[0];
+				*indices++ = vertexIndex[j - 1];
+				*indices++ = vertexIndex[j];
 			}
 		}
 
@@ -931,10 +874,11 @@
 			char matName[MAX_PATH];
 			strncpy(matName,lMaterial->GetName(),MAX_PATH-1);
 
-			auto oIter = m_materials.find(matName);
-			if (oIter != m_materials.end())
+			matName[MAX_PATH-1] = 0;
+			FBXMaterial* existing = m_materials.Find(matName);
+			if (existing != nullptr)
 			{
-				return oIter->second;
+				return existing;
 			}
 			else
 			{
@@ -1072,7 +1016,7 @@
 					}
 				}
 
-				m_materials[material->name] = material;
+				m_materials.Add(material->name, material);
 				return material;
 			}
 		}
@@ -1120,7 +1064,7 @@
 				}
 			}
 
-			m_animations[ anim->m_name ] = anim;
+			m_animations.Add(anim->m_name, anim);
 		}
 	}
 
@@ -1495,87 +1439,18 @@
 	}
 
 	//////////////////////////////////////////////////////////////////////////
-	// SLOWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWW
-	// TODO: Find a faster way to only add unique verts :(
-	unsigned int FBXScene::AddVertGetIndex(std::vector<FBXVertex>& a_vertices, const FBXVertex& a_vertex)
+	// hashed lookup so only unique verts are added in linear time
+	unsigned int FBXScene::AddVertGetIndex(std::vector<FBXVertex>& a_vertices, const FBXVertex& a_vertex, TVertexWelder<FBXVertex, float>& a_welder)
 	{
-		auto oIter = std::find(a_vertices.begin(),a_vertices.end(),a_vertex);
-		if (oIter != a_vertices.end())
-		{
-			return oIter - a_vertices.begin();
-		}
-		a_vertices.push_back(a_vertex);
-		return a_vertices.size() - 1;
+		return a_welder.AddVertGetIndex(a_vertices,a_vertex);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 	void FBXScene::CalculateTangentsBinormals(std::vector<FBXVertex>& a_vertices, const std::vector<unsigned int>& a_indices)
 	{
-		unsigned int vertexCount = a_vertices.size();
-		vec4* tan1 = new vec4[vertexCount * 2];
-		vec4* tan2 = tan1 + vertexCount;
-		memset(tan1, 0, vertexCount * sizeof(vec4) * 2);
-
-		unsigned int indexCount = a_indices.size();
-		for (unsigned int a = 0; a < indexCount; a += 3)
-		{
-			long i1 = a_indices[a];
-			long i2 = a_indices[a + 1];
-			long i3 = a_indices[a + 2];
-
-			const vec4& v1 = a_vertices[i1].position;
-			const vec4& v2 = a_vertices[i2].position;
-			const vec4& v3 = a_vertices[i3].position;
-
-			const vec2& w1 = a_vertices[i1].uv;
-			const vec2& w2 = a_vertices[i2].uv;
-			const vec2& w3 = a_vertices[i3].uv;
-
-			float x1 = v2.x - v1.x;
-			float x2 = v3.x - v1.x;
-			float y1 = v2.y - v1.y;
-			float y2 = v3.y - v1.y;
-			float z1 = v2.z - v1.z;
-			float z2 = v3.z - v1.z;
-
-			float s1 = w2.x - w1.x;
-			float s2 = w3.x - w1.x;
-			float t1 = w2.y - w1.y;
-			float t2 = w3.y - w1.y;
-
-			float r = 1.0F / (s1 * t2 - s2 * t1);
-			vec4 sdir((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r,
-				(t2 * z1 - t1 * z2) * r,0);
-			vec4 tdir((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r,
-				(s1 * z2 - s2 * z1) * r,0);
-
-			tan1[i1] += sdir;
-			tan1[i2] += sdir;
-			tan1[i3] += sdir;
-
-			tan2[i1] += tdir;
-			tan2[i2] += tdir;
-			tan2[i3] += tdir;
-		}
-
-		for (unsigned int a = 0; a < vertexCount; a++)
-		{
-			const vec4& n = a_vertices[a].normal;
-			const vec4& t = tan1[a];
-
-			// Gram-Schmidt orthogonalize
-			a_vertices[a].tangent = (t - n * glm::dot(n, t));
-			glm::normalize(a_vertices[a].tangent);
-
-			// Calculate handedness
-			a_vertices[a].tangent.w = (dot(cross(vec3(n), vec3(t)), vec3(tan2[a])) < 0.0F) ? -1.0F : 1.0F;
-
-			// calculate binormal
-			a_vertices[a].binormal = vec4(cross(vec3(a_vertices[a].normal.x, a_vertices[a].normal.y, a_vertices[a].normal.z),
-			 vec3(a_vertices[a].tangent.x, a_vertices[a].tangent.y, a_vertices[a].tangent.z)), a_vertices[a].tangent.w);
-		}
-
-		delete[] tan1;
+		GenerateTangents<FBXVertex, float>(a_vertices, a_indices,
+			FBXVertex::PositionOffset, FBXVertex::NormalOffset, FBXVertex::UVOffset,
+			FBXVertex::TangentOffset, FBXVertex::BiNormalOffset);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
@@ -1601,36 +1476,19 @@
 		fwrite(&m_ambientLight,sizeof(vec4),1,pFile);
 
 		// material count
-		unsigned int uiCount = m_materials.size();
+		unsigned int uiCount = m_materials.Size();
 		fwrite(&uiCount,sizeof(unsigned int),1,pFile);
 
-
-		#ifdef _MSC_VER		
-		
 		// for each material
-		for (std::map<std::string, FBXMaterial*>::iterator l_Iter = m_materials.begin(); l_Iter != m_materials.end(); l_Iter++)
+		for ( i = 0 ; i < m_materials.Size() ; ++i )
 		{
-			uiAddress = (unsigned int)l_Iter._Ptr->_Myval.second;
+			uiAddress = (unsigned int)m_materials.Get(i);
 
 			// write pointer address
 			fwrite(&uiAddress,sizeof(unsigned int),1,pFile);
 			// write material data
-			fwrite(l_Iter._Ptr->_Myval.second,sizeof(FBXMaterial),1,pFile);
+			fwrite(m_materials.Get(i),sizeof(FBXMaterial),1,pFile);
 		}
-		
-		#else
-		
-		for(auto l_Iter : m_materials)
-		{
-			uiAddress = (unsigned int)l_Iter.second;
-
-			// write pointer address
-			fwrite(&uiAddress,sizeof(unsigned int),1,pFile);
-			// write material data
-			fwrite(l_Iter.second,sizeof(FBXMaterial),1,pFile);			
-		}	
-		
-		#endif
 
 		// write node count
 		uiCount = NodeCount(m_root);
@@ -1650,47 +1508,27 @@
 		}
 
 		// animation count
-		uiCount = m_animations.size();
+		uiCount = m_animations.Size();
 		fwrite(&uiCount,sizeof(unsigned int),1,pFile);
-		
-		#ifdef _MSC_VER
 
-		for (std::map<std::string, FBXAnimation*>::iterator l_Iter = m_animations.begin(); l_Iter != m_animations.end(); l_Iter++)
+		for ( j = 0 ; j < m_animations.Size() ; ++j )
 		{
+			FBXAnimation* anim = m_animations.Get(j);
+
 			// write anim data, then each track in order
-			fwrite(l_Iter._Ptr->_Myval.second->m_name,sizeof(char),MAX_PATH,pFile);
-			fwrite(&l_Iter._Ptr->_Myval.second->m_startFrame,sizeof(unsigned int),1,pFile);
-			fwrite(&l_Iter._Ptr->_Myval.second->m_endFrame,sizeof(unsigned int),1,pFile);
-			fwrite(&l_Iter._Ptr->_Myval.second->m_trackCount,sizeof(unsigned int),1,pFile);
+			fwrite(anim->m_name,sizeof(char),MAX_PATH,pFile);
+			fwrite(&anim->m_startFrame,sizeof(unsigned int),1,pFile);
+			fwrite(&anim->m_endFrame,sizeof(unsigned int),1,pFile);
+			fwrite(&anim->m_trackCount,sizeof(unsigned int),1,pFile);
 
 			// each track writes keyframes in order
-			for ( i = 0 ; i < l_Iter._Ptr->_Myval.second->m_trackCount ; ++i )
+			for ( i = 0 ; i < anim->m_trackCount ; ++i )
 			{
-				fwrite(&l_Iter._Ptr->_Myval.second->m_tracks[i].m_boneIndex,sizeof(unsigned int),1,pFile);
-				fwrite(&l_Iter._Ptr->_Myval.second->m_tracks[i].m_keyframeCount,sizeof(unsigned int),1,pFile);
-				fwrite(l_Iter._Ptr->_Myval.second->m_tracks[i].m_keyframes,sizeof(FBXKeyFrame),l_Iter._Ptr->_Myval.second->m_tracks[i].m_keyframeCount,pFile);				
+				fwrite(&anim->m_tracks[i].m_boneIndex,sizeof(unsigned int),1,pFile);
+				fwrite(&anim->m_tracks[i].m_keyframeCount,sizeof(unsigned int),1,pFile);
+				fwrite(anim->m_tracks[i].m_keyframes,sizeof(FBXKeyFrame),anim->m_tracks[i].m_keyframeCount,pFile);
 			}
 		}
-		
-		#else
-		for(auto l_Iter : m_animations)
-		{
-			// write anim data, then each track in order
-			fwrite(l_Iter.second->m_name,sizeof(char),MAX_PATH,pFile);
-			fwrite(&l_Iter.second->m_startFrame,sizeof(unsigned int),1,pFile);
-			fwrite(&l_Iter.second->m_endFrame,sizeof(unsigned int),1,pFile);
-			fwrite(&l_Iter.second->m_trackCount,sizeof(unsigned int),1,pFile);
-
-			// each track writes keyframes in order
-			for ( i = 0 ; i < l_Iter.second->m_trackCount ; ++i )
-			{
-				fwrite(&l_Iter.second->m_tracks[i].m_boneIndex,sizeof(unsigned int),1,pFile);
-				fwrite(&l_Iter.second->m_tracks[i].m_keyframeCount,sizeof(unsigned int),1,pFile);
-				fwrite(l_Iter.second->m_tracks[i].m_keyframes,sizeof(FBXKeyFrame),l_Iter.second->m_tracks[i].m_keyframeCount,pFile);				
-			}			
-		}		
-		
-		#endif
 
 		fclose(pFile);
 
@@ -1828,7 +1666,7 @@
 			fread(m,sizeof(FBXMaterial),1,pFile);
 
 			materials[ uiAddress ] = m;
-			m_materials[ m->name ] = m;
+			m_materials.Add(m->name, m);
 		}
 
 		// node count
@@ -1890,7 +1728,7 @@
 				fread(anim->m_tracks[j].m_keyframes,sizeof(FBXKeyFrame),anim->m_tracks[j].m_keyframeCount,pFile);				
 			}
 
-			m_animations[ anim->m_name ] = anim;
+			m_animations.Add(anim->m_name, anim);
 		}
 
 		fclose(pFile);
@@ -1964,9 +1802,9 @@
 
 		switch (uiType)
 		{
-		case Node::MESH:	m_meshes[ pNode->m_name ] = (FBXMeshNode*)pNode;	break;
-		case Node::LIGHT:	m_lights[ pNode->m_name ] = (FBXLightNode*)pNode;	break;
-		case Node::CAMERA:	m_cameras[ pNode->m_name ] = (FBXCameraNode*)pNode;	break;
+		case Node::MESH:	m_meshes.Add(pNode->m_name, (FBXMeshNode*)pNode);	break;
+		case Node::LIGHT:	m_lights.Add(pNode->m_name, (FBXLightNode*)pNode);	break;
+		case Node::CAMERA:	m_cameras.Add(pNode->m_name, (FBXCameraNode*)pNode);	break;
 		default:	break;
 		};
 
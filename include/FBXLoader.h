@@ -20,6 +20,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "Utilities.h"
+#include "TinyHelpers.h"
 
 
 
@@ -59,7 +60,8 @@
 			BiNormalOffset	= TangentOffset + sizeof(glm::vec4),
 			IndicesOffset	= BiNormalOffset + sizeof(glm::vec4),
 			WeightsOffset	= IndicesOffset + sizeof(glm::vec4),
-			UVOffset	= WeightsOffset + sizeof(glm::vec4),			
+			UVOffset	= WeightsOffset + sizeof(glm::vec4),
+			ControlPointOffset	= UVOffset + sizeof(glm::vec2) * 2,
 		};
 
 		glm::vec4	position;
@@ -291,13 +293,13 @@
 	};
 
 	// An FBX scene representing the contents on an FBX file.
-	// Stores individual items within maps, with names as the key.
+	// Stores individual items in tables indexed by position and by name.
 	// Also has a pointer to the root of the scene's node tree.
 	class FBXScene
 	{
 	public:
 
-		FBXScene() : m_root(nullptr) {}
+		FBXScene() : m_root(nullptr), m_weldEpsilon(0) {}
 		~FBXScene() 
 		{
 			Unload();
@@ -321,12 +323,15 @@
 		// the ambient light of the scene
 		const glm::vec4&		GetAmbientLight() const		{	return m_ambientLight;	}
 
-		unsigned int	GetMeshCount() const		{	return m_meshes.size();		}
-		unsigned int	GetLightCount() const		{	return m_lights.size();		}
-		unsigned int	GetCameraCount() const		{	return m_cameras.size();	}
-		unsigned int	GetMaterialCount() const	{	return m_materials.size();	}
+		// vertices closer than this are welded on import, 0 only welds exact matches
+		void			SetWeldEpsilon(float a_epsilon)	{	m_weldEpsilon = a_epsilon;	}
+
+		unsigned int	GetMeshCount() const		{	return m_meshes.Size();		}
+		unsigned int	GetLightCount() const		{	return m_lights.Size();		}
+		unsigned int	GetCameraCount() const		{	return m_cameras.Size();	}
+		unsigned int	GetMaterialCount() const	{	return m_materials.Size();	}
 		unsigned int	GetSkeletonCount() const	{	return m_skeletons.size();	}
-		unsigned int	GetAnimationCount() const	{	return m_animations.size();	}
+		unsigned int	GetAnimationCount() const	{	return m_animations.Size();	}
 
 		FBXMeshNode*	GetMeshByName(const char* a_name);
 		FBXLightNode*	GetLightByName(const char* a_name);
@@ -334,7 +339,7 @@
 		FBXMaterial*	GetMaterialByName(const char* a_name);
 		FBXAnimation*	GetAnimationByName(const char* a_name);
 
-		// these methods are slow as the items are stored in a map
+		// indices follow the order items were loaded in
 		FBXMeshNode*	GetMeshByIndex(unsigned int a_index);
 		FBXLightNode*	GetLightByIndex(unsigned int a_index);
 		FBXCameraNode*	GetCameraByIndex(unsigned int a_index);
@@ -360,7 +365,7 @@
 		FBXMaterial*	ExtractMaterial(void* a_mesh);
 
 		// helpers used for building meshes
-		unsigned int AddVertGetIndex(std::vector<FBXVertex>& a_vertices, const FBXVertex& a_vertex);
+		unsigned int AddVertGetIndex(std::vector<FBXVertex>& a_vertices, const FBXVertex& a_vertex, TVertexWelder<FBXVertex, float>& a_welder);
 		void CalculateTangentsBinormals(std::vector<FBXVertex>& a_vertices, const std::vector<unsigned int>& a_indices);
 
 		void	SaveNode(Node* a_node, FILE* a_file);
@@ -384,13 +389,14 @@
 		std::string								m_path;
 
 		glm::vec4								m_ambientLight;
-		std::map<std::string,FBXMeshNode*>		m_meshes;
-		std::map<std::string,FBXLightNode*>		m_lights;
-		std::map<std::string,FBXCameraNode*>	m_cameras;
-		std::map<std::string,FBXMaterial*>		m_materials;
+		float									m_weldEpsilon;
+		TAssetTable<FBXMeshNode>				m_meshes;
+		TAssetTable<FBXLightNode>				m_lights;
+		TAssetTable<FBXCameraNode>				m_cameras;
+		TAssetTable<FBXMaterial>				m_materials;
 
 		std::vector<FBXSkeleton*>				m_skeletons;
-		std::map<std::string,FBXAnimation*>		m_animations;
+		TAssetTable<FBXAnimation>				m_animations;
 	};
 
 
@@ -0,0 +1,3957 @@
+#ifndef TINYHELPERS_H
+#define TINYHELPERS_H
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+//loader agnostic helpers shared by TScene and FBXScene. nothing in here
+//touches the FBX SDK so it can be used on data loaded from a binary file too.
+
+inline unsigned long long MixHash(unsigned long long Hash, unsigned long long Value)
+{
+	Hash ^= Value + 0x9e3779b97f4a7c15ULL + (Hash << 6) + (Hash >> 2);
+	Hash ^= Hash >> 33;
+	Hash *= 0xff51afd7ed558ccdULL;
+	Hash ^= Hash >> 33;
+	return Hash;
+}
+
+//worker threads used when a caller asks for 0
+inline unsigned int DefaultThreadCount()
+{
+	unsigned int Count = std::thread::hardware_concurrency();
+	return (Count > 0) ? Count : 1;
+}
+
+inline bool& InsideParallelFor()
+{
+	static thread_local bool Inside = false;
+	return Inside;
+}
+
+//persistent workers behind ParallelFor, started the first time they are
+//needed and kept asleep between jobs so small loops do not pay for creating
+//threads. one job runs at a time, Run returns false when another thread
+//already has the pool so the caller can do the work itself
+class TThreadPool
+{
+public:
+
+	static TThreadPool& Get()
+	{
+		static TThreadPool Pool;
+		return Pool;
+	}
+
+	~TThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			Stop = true;
+		}
+		Wake.notify_all();
+
+		for (unsigned int WorkerIter = 0; WorkerIter < Workers.size(); WorkerIter++)
+		{
+			Workers[WorkerIter].join();
+		}
+	}
+
+	//calls Task(Context, Index) for every Index below Count on the calling
+	//thread and ThreadCount - 1 workers, returning once all of them are done
+	bool Run(unsigned int Count, unsigned int ThreadCount, void (*Task)(const void*, unsigned int), const void* Context)
+	{
+		std::unique_lock<std::mutex> Submit(SubmitMutex, std::try_to_lock);
+		if (!Submit.owns_lock())
+		{
+			return false;
+		}
+
+		{
+			std::unique_lock<std::mutex> Lock(Mutex);
+			while (Workers.size() < ThreadCount - 1)
+			{
+				Workers.push_back(std::thread(&TThreadPool::Work, this, (unsigned int)Workers.size()));
+			}
+
+			JobTask = Task;
+			JobContext = Context;
+			JobCount = Count;
+			Next = 0;
+			Helpers = ThreadCount - 1;
+			Busy = Helpers;
+			Generation++;
+		}
+		Wake.notify_all();
+
+		InsideParallelFor() = true;
+		Drain();
+		InsideParallelFor() = false;
+
+		std::unique_lock<std::mutex> Lock(Mutex);
+		Done.wait(Lock, [this]() { return Busy == 0; });
+		return true;
+	}
+
+private:
+
+	TThreadPool() : JobTask(nullptr), JobContext(nullptr), JobCount(0), Next(0),
+		Helpers(0), Busy(0), Generation(0), Stop(false){};
+
+	void Drain()
+	{
+		for (unsigned int Iter = Next++; Iter < JobCount; Iter = Next++)
+		{
+			JobTask(JobContext, Iter);
+		}
+	}
+
+	void Work(unsigned int Index)
+	{
+		InsideParallelFor() = true;
+		unsigned int Seen = 0;
+
+		std::unique_lock<std::mutex> Lock(Mutex);
+		while (true)
+		{
+			Wake.wait(Lock, [&]() { return Stop || Generation != Seen; });
+			if (Stop)
+			{
+				return;
+			}
+
+			//workers past the job's thread count sit this one out
+			Seen = Generation;
+			if (Index >= Helpers)
+			{
+				continue;
+			}
+
+			Lock.unlock();
+			Drain();
+			Lock.lock();
+
+			if (--Busy == 0)
+			{
+				Done.notify_one();
+			}
+		}
+	}
+
+	std::vector<std::thread> Workers;
+	std::mutex SubmitMutex;
+	std::mutex Mutex;
+	std::condition_variable Wake;
+	std::condition_variable Done;
+
+	void (*JobTask)(const void*, unsigned int);
+	const void* JobContext;
+	unsigned int JobCount;
+	std::atomic<unsigned int> Next;
+	unsigned int Helpers;
+	unsigned int Busy;
+	unsigned int Generation;
+	bool Stop;
+};
+
+template<typename TaskType>
+void InvokeParallelTask(const void* Task, unsigned int Index)
+{
+	(*(const TaskType*)Task)(Index);
+}
+
+//runs Task(Index) for every Index below Count across up to ThreadCount
+//threads (0 uses every core) from the shared TThreadPool. indices are handed
+//out one at a time so uneven tasks still balance. a ParallelFor started from
+//inside another one, or while another thread holds the pool, runs serially
+//on the calling thread instead of oversubscribing the machine.
+template<typename TaskType>
+void ParallelFor(unsigned int Count, unsigned int ThreadCount, const TaskType& Task)
+{
+	if (ThreadCount == 0)
+	{
+		ThreadCount = DefaultThreadCount();
+	}
+
+	if (ThreadCount > Count)
+	{
+		ThreadCount = Count;
+	}
+
+	if (ThreadCount <= 1 || InsideParallelFor() ||
+		!TThreadPool::Get().Run(Count, ThreadCount, &InvokeParallelTask<TaskType>, &Task))
+	{
+		for (unsigned int Iter = 0; Iter < Count; Iter++)
+		{
+			Task(Iter);
+		}
+	}
+}
+
+//converts Count elements of Components doubles each into Type. strides are in
+//scalars. kept free of branches so the compiler can vectorize it.
+template<unsigned int Components, typename Type>
+void ConvertDoubles(const double* Source, unsigned int SourceStride,
+	Type* Destination, unsigned int DestinationStride, unsigned int Count)
+{
+	for (unsigned int Iter = 0; Iter < Count; Iter++)
+	{
+		const double* From = Source + Iter * SourceStride;
+		Type* To = Destination + Iter * DestinationStride;
+		for (unsigned int Component = 0; Component < Components; Component++)
+		{
+			To[Component] = (Type)From[Component];
+		}
+	}
+}
+
+//groups Count items by key in CSR form: the items with key K are
+//Items[Offsets[K]] up to Items[Offsets[K + 1]], in ascending item order.
+//items whose key is KeyCount or above are dropped.
+template<typename KeyFunction>
+void BuildBuckets(unsigned int Count, unsigned int KeyCount, const KeyFunction& Key,
+	std::vector<unsigned int>& Offsets, std::vector<unsigned int>& Items)
+{
+	Offsets.assign(KeyCount + 1, 0);
+	for (unsigned int Iter = 0; Iter < Count; Iter++)
+	{
+		unsigned int Bucket = Key(Iter);
+		if (Bucket < KeyCount)
+		{
+			Offsets[Bucket + 1]++;
+		}
+	}
+
+	for (unsigned int Bucket = 0; Bucket < KeyCount; Bucket++)
+	{
+		Offsets[Bucket + 1] += Offsets[Bucket];
+	}
+
+	std::vector<unsigned int> Cursor(Offsets.begin(), Offsets.end() - 1);
+	Items.resize(Offsets[KeyCount]);
+	for (unsigned int Iter = 0; Iter < Count; Iter++)
+	{
+		unsigned int Bucket = Key(Iter);
+		if (Bucket < KeyCount)
+		{
+			Items[Cursor[Bucket]++] = Iter;
+		}
+	}
+}
+
+//Result = A * B for row major 4x4 matrices. Result must not alias A or B
+template<typename Type>
+void MultiplyMatrix(const Type* A, const Type* B, Type* Result)
+{
+	for (unsigned int Row = 0; Row < 4; Row++)
+	{
+		for (unsigned int Column = 0; Column < 4; Column++)
+		{
+			Result[Row * 4 + Column] =
+				A[Row * 4 + 0] * B[0 * 4 + Column] +
+				A[Row * 4 + 1] * B[1 * 4 + Column] +
+				A[Row * 4 + 2] * B[2 * 4 + Column] +
+				A[Row * 4 + 3] * B[3 * 4 + Column];
+		}
+	}
+}
+
+//builds a row major matrix laid out like FbxAMatrix (translation in the last
+//row) from a translation, a unit quaternion stored x, y, z, w and a scale
+template<typename Type>
+void ComposeTransform(const Type* Translation, const Type* Rotation, const Type* Scale, Type* Result)
+{
+	Type X = Rotation[0], Y = Rotation[1], Z = Rotation[2], W = Rotation[3];
+
+	Result[0] = (1 - 2 * (Y * Y + Z * Z)) * Scale[0];
+	Result[1] = (2 * (X * Y + W * Z)) * Scale[0];
+	Result[2] = (2 * (X * Z - W * Y)) * Scale[0];
+	Result[3] = 0;
+
+	Result[4] = (2 * (X * Y - W * Z)) * Scale[1];
+	Result[5] = (1 - 2 * (X * X + Z * Z)) * Scale[1];
+	Result[6] = (2 * (Y * Z + W * X)) * Scale[1];
+	Result[7] = 0;
+
+	Result[8] = (2 * (X * Z + W * Y)) * Scale[2];
+	Result[9] = (2 * (Y * Z - W * X)) * Scale[2];
+	Result[10] = (1 - 2 * (X * X + Y * Y)) * Scale[2];
+	Result[11] = 0;
+
+	Result[12] = Translation[0];
+	Result[13] = Translation[1];
+	Result[14] = Translation[2];
+	Result[15] = 1;
+}
+
+//right handed view matrix in the same layout, matching glm::lookAt
+template<typename Type>
+void LookAtMatrix(const Type* Eye, const Type* Target, const Type* Up, Type* Result)
+{
+	Type Forward[3] = { Target[0] - Eye[0], Target[1] - Eye[1], Target[2] - Eye[2] };
+	Type Length = sqrt(Forward[0] * Forward[0] + Forward[1] * Forward[1] + Forward[2] * Forward[2]);
+	for (unsigned int Component = 0; Component < 3; Component++)
+	{
+		Forward[Component] = (Length > 0) ? Forward[Component] / Length : 0;
+	}
+
+	Type Side[3] =
+	{
+		Forward[1] * Up[2] - Forward[2] * Up[1],
+		Forward[2] * Up[0] - Forward[0] * Up[2],
+		Forward[0] * Up[1] - Forward[1] * Up[0]
+	};
+	Length = sqrt(Side[0] * Side[0] + Side[1] * Side[1] + Side[2] * Side[2]);
+	for (unsigned int Component = 0; Component < 3; Component++)
+	{
+		Side[Component] = (Length > 0) ? Side[Component] / Length : 0;
+	}
+
+	Type CameraUp[3] =
+	{
+		Side[1] * Forward[2] - Side[2] * Forward[1],
+		Side[2] * Forward[0] - Side[0] * Forward[2],
+		Side[0] * Forward[1] - Side[1] * Forward[0]
+	};
+
+	for (unsigned int Row = 0; Row < 3; Row++)
+	{
+		Result[Row * 4 + 0] = Side[Row];
+		Result[Row * 4 + 1] = CameraUp[Row];
+		Result[Row * 4 + 2] = -Forward[Row];
+		Result[Row * 4 + 3] = 0;
+	}
+
+	Result[12] = -(Side[0] * Eye[0] + Side[1] * Eye[1] + Side[2] * Eye[2]);
+	Result[13] = -(CameraUp[0] * Eye[0] + CameraUp[1] * Eye[1] + CameraUp[2] * Eye[2]);
+	Result[14] = Forward[0] * Eye[0] + Forward[1] * Eye[1] + Forward[2] * Eye[2];
+	Result[15] = 1;
+}
+
+//OpenGL style perspective projection in the same layout, matching glm::perspective.
+//FOV is the vertical field of view in radians
+template<typename Type>
+void PerspectiveMatrix(Type FOV, Type AspectRatio, Type Near, Type Far, Type* Result)
+{
+	Type Focal = 1 / tan(FOV / 2);
+	memset(Result, 0, sizeof(Type) * 16);
+
+	Result[0] = Focal / AspectRatio;
+	Result[5] = Focal;
+	Result[10] = -(Far + Near) / (Far - Near);
+	Result[11] = -1;
+	Result[14] = -(2 * Far * Near) / (Far - Near);
+}
+
+//packs a unit quaternion stored x, y, z, w into 48 bits. the largest component
+//is dropped and rebuilt from the other three, which land in the top 15 bits of
+//each short. the low bits of the first two hold which component was dropped
+template<typename Type>
+void PackQuaternion(const Type* Quaternion, unsigned short* Packed)
+{
+	unsigned int Largest = 0;
+	for (unsigned int Iter = 1; Iter < 4; Iter++)
+	{
+		if (fabs(Quaternion[Iter]) > fabs(Quaternion[Largest]))
+		{
+			Largest = Iter;
+		}
+	}
+
+	//q and -q are the same rotation so the dropped component is always made positive
+	Type Sign = (Quaternion[Largest] < 0) ? (Type)-1 : (Type)1;
+	const Type Scale = (Type)(0.5 * 32767.0);
+
+	unsigned int Lane = 0;
+	for (unsigned int Iter = 0; Iter < 4; Iter++)
+	{
+		if (Iter == Largest)
+		{
+			continue;
+		}
+
+		Type Value = (Quaternion[Iter] * Sign * (Type)1.41421356237309505 + 1) * Scale;
+		Value = (Value < 0) ? 0 : ((Value > 32767) ? 32767 : Value);
+		Packed[Lane++] = (unsigned short)((unsigned int)(Value + (Type)0.5) << 1);
+	}
+	Packed[0] |= Largest & 1;
+	Packed[1] |= (Largest >> 1) & 1;
+}
+
+template<typename Type>
+void UnpackQuaternion(const unsigned short* Packed, Type* Quaternion)
+{
+	unsigned int Largest = (Packed[0] & 1) | ((Packed[1] & 1) << 1);
+
+	Type Lanes[3];
+	Type Sum = 0;
+	for (unsigned int Lane = 0; Lane < 3; Lane++)
+	{
+		Lanes[Lane] = ((Type)(Packed[Lane] >> 1) * (Type)(2.0 / 32767.0) - 1) * (Type)0.70710678118654752;
+		Sum += Lanes[Lane] * Lanes[Lane];
+	}
+
+	unsigned int Lane = 0;
+	for (unsigned int Iter = 0; Iter < 4; Iter++)
+	{
+		Quaternion[Iter] = (Iter == Largest) ? (Type)sqrt(std::max((Type)0, 1 - Sum)) : Lanes[Lane++];
+	}
+}
+
+//maps Value inside [Min, Min + Range] onto the full 16 bit range
+template<typename Type>
+unsigned short QuantizeRange(Type Value, Type Min, Type Range)
+{
+	if (Range <= 0)
+	{
+		return 0;
+	}
+
+	Type Scaled = (Value - Min) / Range * 65535 + (Type)0.5;
+	return (unsigned short)((Scaled < 0) ? 0 : ((Scaled > 65535) ? 65535 : Scaled));
+}
+
+//shortest arc slerp between unit quaternions stored x, y, z, w. nearly
+//parallel inputs fall back to a normalized lerp
+template<typename Type>
+void Slerp(const Type* A, const Type* B, Type T, Type* Result)
+{
+	Type CosTheta = A[0] * B[0] + A[1] * B[1] + A[2] * B[2] + A[3] * B[3];
+	Type Sign = 1;
+	if (CosTheta < 0)
+	{
+		CosTheta = -CosTheta;
+		Sign = -1;
+	}
+
+	Type RatioA = 1 - T;
+	Type RatioB = T;
+	if (CosTheta < (Type)0.9995)
+	{
+		Type Theta = acos(CosTheta);
+		Type SinTheta = sin(Theta);
+		RatioA = sin((1 - T) * Theta) / SinTheta;
+		RatioB = sin(T * Theta) / SinTheta;
+	}
+
+	Type Length = 0;
+	for (unsigned int Iter = 0; Iter < 4; Iter++)
+	{
+		Result[Iter] = A[Iter] * RatioA + B[Iter] * RatioB * Sign;
+		Length += Result[Iter] * Result[Iter];
+	}
+
+	if (Length > 0)
+	{
+		Length = sqrt(Length);
+		for (unsigned int Iter = 0; Iter < 4; Iter++)
+		{
+			Result[Iter] /= Length;
+		}
+	}
+}
+
+//a single bone weight on a vertex
+struct TInfluence
+{
+	unsigned int Bone;
+	float Weight;
+};
+
+//folds repeated bones together, keeps the MaxCount strongest influences
+//(ties go to the lower bone index) sorted strongest first and rescales them
+//to sum to 1. returns how many influences were kept.
+inline unsigned int SelectInfluences(TInfluence* Influences, unsigned int Count, unsigned int MaxCount)
+{
+	std::sort(Influences, Influences + Count, [](const TInfluence& A, const TInfluence& B)
+	{
+		return A.Bone < B.Bone;
+	});
+
+	unsigned int Unique = 0;
+	for (unsigned int Iter = 0; Iter < Count; Iter++)
+	{
+		if (Unique > 0 && Influences[Unique - 1].Bone == Influences[Iter].Bone)
+		{
+			Influences[Unique - 1].Weight += Influences[Iter].Weight;
+		}
+		else
+		{
+			Influences[Unique++] = Influences[Iter];
+		}
+	}
+
+	std::stable_sort(Influences, Influences + Unique, [](const TInfluence& A, const TInfluence& B)
+	{
+		return A.Weight > B.Weight;
+	});
+
+	while (Unique > 0 && Influences[Unique - 1].Weight <= 0)
+	{
+		Unique--;
+	}
+
+	unsigned int Kept = (Unique < MaxCount) ? Unique : MaxCount;
+	float Sum = 0;
+	for (unsigned int Iter = 0; Iter < Kept; Iter++)
+	{
+		Sum += Influences[Iter].Weight;
+	}
+
+	for (unsigned int Iter = 0; Iter < Kept; Iter++)
+	{
+		Influences[Iter].Weight /= Sum;
+	}
+	return Kept;
+}
+
+//quantizes Count weights that sum to 1 onto 0 - MaxValue. leftover units go
+//to the largest rounding remainders so the results always sum to MaxValue.
+//only the first 32 weights are used
+inline void QuantizeWeights(const float* Weights, unsigned int Count, unsigned int MaxValue, unsigned int* Quantized)
+{
+	float Remainders[32];
+	unsigned int Total = 0;
+	Count = (Count < 32) ? Count : 32;
+
+	for (unsigned int Iter = 0; Iter < Count; Iter++)
+	{
+		float Scaled = Weights[Iter] * MaxValue;
+		Quantized[Iter] = (unsigned int)Scaled;
+		Remainders[Iter] = Scaled - Quantized[Iter];
+		Total += Quantized[Iter];
+	}
+
+	if (Count == 0 || Total == 0)
+	{
+		return;
+	}
+
+	while (Total < MaxValue)
+	{
+		unsigned int Best = 0;
+		for (unsigned int Iter = 1; Iter < Count; Iter++)
+		{
+			if (Remainders[Iter] > Remainders[Best])
+			{
+				Best = Iter;
+			}
+		}
+		Quantized[Best]++;
+		Remainders[Best] -= 1;
+		Total++;
+	}
+}
+
+//name to index map for import time lookups. names are copied into one pool
+//so keys outlive the buffers they were read from, and are hashed and compared
+//by content. the first index given to a name wins
+class TNameIndex
+{
+public:
+
+	enum
+	{
+		Missing = 0xffffffff
+	};
+
+	TNameIndex() : Count(0)
+	{
+		Rehash(16);
+	}
+
+	//adds Name with Value unless it is already known. returns the value stored for Name
+	unsigned int Insert(const char* Name, unsigned int Value)
+	{
+		if ((Count + 1) * 2 > Slots.size())
+		{
+			Rehash(Slots.size() * 2);
+		}
+
+		unsigned int Hash = HashName(Name);
+		unsigned int Mask = Slots.size() - 1;
+
+		for (unsigned int Slot = Hash & Mask;; Slot = (Slot + 1) & Mask)
+		{
+			unsigned int Entry = Slots[Slot];
+
+			if (Entry == Missing)
+			{
+				Slots[Slot] = Offsets.size();
+				Hashes.push_back(Hash);
+				Offsets.push_back(Pool.size());
+				Values.push_back(Value);
+				Pool.insert(Pool.end(), Name, Name + strlen(Name) + 1);
+				Count++;
+				return Value;
+			}
+
+			if (Hashes[Entry] == Hash && strcmp(&Pool[Offsets[Entry]], Name) == 0)
+			{
+				return Values[Entry];
+			}
+		}
+	}
+
+	//the value stored for Name, or Missing
+	unsigned int Find(const char* Name) const
+	{
+		unsigned int Hash = HashName(Name);
+		unsigned int Mask = Slots.size() - 1;
+
+		for (unsigned int Slot = Hash & Mask;; Slot = (Slot + 1) & Mask)
+		{
+			unsigned int Entry = Slots[Slot];
+
+			if (Entry == Missing)
+			{
+				return Missing;
+			}
+
+			if (Hashes[Entry] == Hash && strcmp(&Pool[Offsets[Entry]], Name) == 0)
+			{
+				return Values[Entry];
+			}
+		}
+	}
+
+	unsigned int Size() const
+	{
+		return Count;
+	}
+
+	void Clear()
+	{
+		Count = 0;
+		Pool.clear();
+		Offsets.clear();
+		Hashes.clear();
+		Values.clear();
+		Slots.clear();
+		Rehash(16);
+	}
+
+private:
+
+	static unsigned int HashName(const char* Name)
+	{
+		//FNV-1a
+		unsigned int Hash = 2166136261u;
+		for (; *Name != '\0'; Name++)
+		{
+			Hash = (Hash ^ (unsigned char)*Name) * 16777619u;
+		}
+		return Hash;
+	}
+
+	void Rehash(unsigned int Capacity)
+	{
+		Slots.assign(Capacity, (unsigned int)Missing);
+		unsigned int Mask = Capacity - 1;
+
+		for (unsigned int Entry = 0; Entry < Hashes.size(); Entry++)
+		{
+			unsigned int Slot = Hashes[Entry] & Mask;
+			while (Slots[Slot] != Missing)
+			{
+				Slot = (Slot + 1) & Mask;
+			}
+			Slots[Slot] = Entry;
+		}
+	}
+
+	unsigned int Count;
+
+	std::vector<char> Pool;
+	std::vector<unsigned int> Offsets;
+	std::vector<unsigned int> Hashes;
+	std::vector<unsigned int> Values;
+	std::vector<unsigned int> Slots;
+};
+
+//assets in the order they were added plus a hashed name index over them, so
+//lookups by index and by name are both constant time. indices stay put until
+//Clear. a name added twice keeps resolving to its first asset
+template<typename AssetType>
+class TAssetTable
+{
+public:
+
+	typedef typename std::vector<AssetType*>::const_iterator TIterator;
+
+	unsigned int Add(const char* Name, AssetType* Asset)
+	{
+		unsigned int Index = Assets.size();
+		Assets.push_back(Asset);
+		Names.Insert(Name, Index);
+		return Index;
+	}
+
+	AssetType* Find(const char* Name) const
+	{
+		unsigned int Index = Names.Find(Name);
+		return (Index != TNameIndex::Missing) ? Assets[Index] : nullptr;
+	}
+
+	AssetType* Get(unsigned int Index) const
+	{
+		return (Index < Assets.size()) ? Assets[Index] : nullptr;
+	}
+
+	unsigned int Size() const
+	{
+		return Assets.size();
+	}
+
+	void Clear()
+	{
+		Assets.clear();
+		Names.Clear();
+	}
+
+	TIterator begin() const
+	{
+		return Assets.begin();
+	}
+
+	TIterator end() const
+	{
+		return Assets.end();
+	}
+
+private:
+
+	std::vector<AssetType*> Assets;
+	TNameIndex Names;
+};
+
+//fills the tangent frames of an indexed triangle list. the layout is given as
+//byte offsets into VertexType so TVertex and FBXVertex share one generator.
+//triangle directions are found in parallel, then every vertex sums the
+//triangles touching it in index order through a vertex -> corner CSR, so the
+//result is the same for any ThreadCount. as in the original FBXScene code the
+//binormal is cross(normal, tangent) and both w lanes hold the handedness, so
+//the bitangent a shader wants is binormal.xyz * binormal.w
+template<typename VertexType, typename ScalarType>
+void GenerateTangents(std::vector<VertexType>& Vertices, const std::vector<unsigned int>& Indices,
+	unsigned int PositionOffset, unsigned int NormalOffset, unsigned int UVOffset,
+	unsigned int TangentOffset, unsigned int BiNormalOffset, unsigned int ThreadCount = 0)
+{
+	unsigned int VertexCount = Vertices.size();
+	unsigned int TriangleCount = Indices.size() / 3;
+	const unsigned int BlockSize = 1024;
+
+	if (VertexCount == 0 || TriangleCount == 0)
+	{
+		return;
+	}
+
+	//per triangle s and t directions, 3 scalars each
+	std::vector<ScalarType> Directions(TriangleCount * 6, 0);
+
+	ParallelFor((TriangleCount + BlockSize - 1) / BlockSize, ThreadCount, [&](unsigned int BlockIter)
+	{
+		unsigned int Last = std::min((BlockIter + 1) * BlockSize, TriangleCount);
+		for (unsigned int Triangle = BlockIter * BlockSize; Triangle < Last; Triangle++)
+		{
+			const unsigned char* Corners[3];
+			for (unsigned int Corner = 0; Corner < 3; Corner++)
+			{
+				Corners[Corner] = (const unsigned char*)&Vertices[Indices[Triangle * 3 + Corner]];
+			}
+
+			const ScalarType* P1 = (const ScalarType*)(Corners[0] + PositionOffset);
+			const ScalarType* P2 = (const ScalarType*)(Corners[1] + PositionOffset);
+			const ScalarType* P3 = (const ScalarType*)(Corners[2] + PositionOffset);
+			const ScalarType* W1 = (const ScalarType*)(Corners[0] + UVOffset);
+			const ScalarType* W2 = (const ScalarType*)(Corners[1] + UVOffset);
+			const ScalarType* W3 = (const ScalarType*)(Corners[2] + UVOffset);
+
+			ScalarType S1 = W2[0] - W1[0];
+			ScalarType S2 = W3[0] - W1[0];
+			ScalarType T1 = W2[1] - W1[1];
+			ScalarType T2 = W3[1] - W1[1];
+
+			//triangles with no uv area add nothing rather than infinities
+			ScalarType Area = S1 * T2 - S2 * T1;
+			ScalarType R = (Area != 0) ? 1 / Area : 0;
+
+			ScalarType* Direction = &Directions[Triangle * 6];
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				ScalarType E1 = P2[Component] - P1[Component];
+				ScalarType E2 = P3[Component] - P1[Component];
+				Direction[Component] = (T2 * E1 - T1 * E2) * R;
+				Direction[3 + Component] = (S1 * E2 - S2 * E1) * R;
+			}
+		}
+	});
+
+	std::vector<unsigned int> CornerOffsets, CornerList;
+	BuildBuckets(TriangleCount * 3, VertexCount,
+		[&](unsigned int Corner) { return Indices[Corner]; },
+		CornerOffsets, CornerList);
+
+	ParallelFor((VertexCount + BlockSize - 1) / BlockSize, ThreadCount, [&](unsigned int BlockIter)
+	{
+		unsigned int First = BlockIter * BlockSize;
+		unsigned int Count = std::min(First + BlockSize, VertexCount) - First;
+
+		//the block is gathered into component arrays so the frame maths runs as straight lane loops
+		ScalarType NX[BlockSize], NY[BlockSize], NZ[BlockSize];
+		ScalarType TX[BlockSize], TY[BlockSize], TZ[BlockSize];
+		ScalarType BX[BlockSize], BY[BlockSize], BZ[BlockSize];
+		ScalarType W[BlockSize];
+
+		for (unsigned int Lane = 0; Lane < Count; Lane++)
+		{
+			unsigned int Vertex = First + Lane;
+			const ScalarType* Normal = (const ScalarType*)((const unsigned char*)&Vertices[Vertex] + NormalOffset);
+			NX[Lane] = Normal[0];
+			NY[Lane] = Normal[1];
+			NZ[Lane] = Normal[2];
+
+			ScalarType Sum[6] = { 0, 0, 0, 0, 0, 0 };
+			for (unsigned int CornerIter = CornerOffsets[Vertex]; CornerIter < CornerOffsets[Vertex + 1]; CornerIter++)
+			{
+				const ScalarType* Direction = &Directions[(CornerList[CornerIter] / 3) * 6];
+				for (unsigned int Component = 0; Component < 6; Component++)
+				{
+					Sum[Component] += Direction[Component];
+				}
+			}
+
+			TX[Lane] = Sum[0];
+			TY[Lane] = Sum[1];
+			TZ[Lane] = Sum[2];
+			BX[Lane] = Sum[3];
+			BY[Lane] = Sum[4];
+			BZ[Lane] = Sum[5];
+		}
+
+		for (unsigned int Lane = 0; Lane < Count; Lane++)
+		{
+			//handedness from the unprojected directions, then gram-schmidt
+			ScalarType CX = NY[Lane] * TZ[Lane] - NZ[Lane] * TY[Lane];
+			ScalarType CY = NZ[Lane] * TX[Lane] - NX[Lane] * TZ[Lane];
+			ScalarType CZ = NX[Lane] * TY[Lane] - NY[Lane] * TX[Lane];
+			W[Lane] = (CX * BX[Lane] + CY * BY[Lane] + CZ * BZ[Lane] < 0) ? (ScalarType)-1 : (ScalarType)1;
+
+			ScalarType Dot = NX[Lane] * TX[Lane] + NY[Lane] * TY[Lane] + NZ[Lane] * TZ[Lane];
+			TX[Lane] -= NX[Lane] * Dot;
+			TY[Lane] -= NY[Lane] * Dot;
+			TZ[Lane] -= NZ[Lane] * Dot;
+
+			ScalarType Length = sqrt(TX[Lane] * TX[Lane] + TY[Lane] * TY[Lane] + TZ[Lane] * TZ[Lane]);
+			ScalarType Scale = (Length > 0) ? 1 / Length : 0;
+			TX[Lane] *= Scale;
+			TY[Lane] *= Scale;
+			TZ[Lane] *= Scale;
+
+			BX[Lane] = NY[Lane] * TZ[Lane] - NZ[Lane] * TY[Lane];
+			BY[Lane] = NZ[Lane] * TX[Lane] - NX[Lane] * TZ[Lane];
+			BZ[Lane] = NX[Lane] * TY[Lane] - NY[Lane] * TX[Lane];
+		}
+
+		for (unsigned int Lane = 0; Lane < Count; Lane++)
+		{
+			unsigned char* Vertex = (unsigned char*)&Vertices[First + Lane];
+			ScalarType* Tangent = (ScalarType*)(Vertex + TangentOffset);
+			ScalarType* BiNormal = (ScalarType*)(Vertex + BiNormalOffset);
+
+			Tangent[0] = TX[Lane];
+			Tangent[1] = TY[Lane];
+			Tangent[2] = TZ[Lane];
+			Tangent[3] = W[Lane];
+
+			BiNormal[0] = BX[Lane];
+			BiNormal[1] = BY[Lane];
+			BiNormal[2] = BZ[Lane];
+			BiNormal[3] = W[Lane];
+		}
+	});
+}
+
+//post transform cache figures for an index buffer. ACMR is vertices
+//transformed per triangle (0.5 at best), ATVR is vertices transformed per
+//vertex in the mesh (1 at best)
+struct TVertexCacheStats
+{
+	TVertexCacheStats() : ACMR(0), ATVR(0){}
+
+	float ACMR;
+	float ATVR;
+};
+
+//simulates a FIFO post transform cache of CacheSize entries
+inline TVertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& Indices, unsigned int VertexCount, unsigned int CacheSize = 16)
+{
+	TVertexCacheStats Stats;
+	unsigned int IndexCount = Indices.size();
+	if (IndexCount < 3 || VertexCount == 0)
+	{
+		return Stats;
+	}
+
+	//a vertex is still cached while fewer than CacheSize misses came after its own
+	std::vector<unsigned int> MissTimes(VertexCount, 0);
+	unsigned int Misses = 0;
+
+	for (unsigned int IndexIter = 0; IndexIter < IndexCount; IndexIter++)
+	{
+		unsigned int Vertex = Indices[IndexIter];
+		if (Vertex >= VertexCount)
+		{
+			continue;
+		}
+
+		if (MissTimes[Vertex] == 0 || Misses + 1 - MissTimes[Vertex] > CacheSize)
+		{
+			MissTimes[Vertex] = ++Misses;
+		}
+	}
+
+	Stats.ACMR = (float)Misses / (float)(IndexCount / 3);
+	Stats.ATVR = (float)Misses / (float)VertexCount;
+	return Stats;
+}
+
+//reorders triangles for the post transform cache with Tom Forsyth's linear
+//speed method: a 32 entry LRU model scores each vertex by cache position and
+//by how few triangles still use it, and the best scored triangle touching the
+//cache is emitted next
+inline void OptimizeVertexCache(std::vector<unsigned int>& Indices, unsigned int VertexCount)
+{
+	const unsigned int CacheSize = 32;
+	const unsigned int MaxValence = 32;
+	unsigned int TriangleCount = Indices.size() / 3;
+
+	if (TriangleCount == 0 || VertexCount == 0)
+	{
+		return;
+	}
+
+	float CacheScores[CacheSize];
+	for (unsigned int Position = 0; Position < CacheSize; Position++)
+	{
+		//the last triangle's vertices get a flat score so it is not simply repeated
+		CacheScores[Position] = (Position < 3) ? 0.75f :
+			powf(1.0f - (float)(Position - 3) / (float)(CacheSize - 3), 1.5f);
+	}
+
+	float ValenceScores[MaxValence + 1];
+	ValenceScores[0] = 0;
+	for (unsigned int Valence = 1; Valence <= MaxValence; Valence++)
+	{
+		ValenceScores[Valence] = 2.0f / sqrtf((float)Valence);
+	}
+
+	//vertex -> triangles still waiting to be emitted, kept in the first Live[V] slots
+	std::vector<unsigned int> Offsets, Triangles;
+	BuildBuckets(TriangleCount * 3, VertexCount,
+		[&](unsigned int Corner) { return Indices[Corner]; },
+		Offsets, Triangles);
+
+	for (unsigned int TriangleIter = 0; TriangleIter < Triangles.size(); TriangleIter++)
+	{
+		Triangles[TriangleIter] /= 3;
+	}
+
+	std::vector<unsigned int> Live(VertexCount);
+	std::vector<int> CachePositions(VertexCount, -1);
+	std::vector<float> VertexScores(VertexCount);
+
+	auto ScoreVertex = [&](unsigned int Vertex) -> float
+	{
+		if (Live[Vertex] == 0)
+		{
+			return -1.0f;
+		}
+
+		float Score = ValenceScores[std::min(Live[Vertex], MaxValence)];
+		if (CachePositions[Vertex] >= 0)
+		{
+			Score += CacheScores[CachePositions[Vertex]];
+		}
+		return Score;
+	};
+
+	for (unsigned int Vertex = 0; Vertex < VertexCount; Vertex++)
+	{
+		Live[Vertex] = Offsets[Vertex + 1] - Offsets[Vertex];
+		VertexScores[Vertex] = ScoreVertex(Vertex);
+	}
+
+	std::vector<float> TriangleScores(TriangleCount);
+	std::vector<unsigned char> Emitted(TriangleCount, 0);
+	unsigned int Best = 0;
+
+	for (unsigned int Triangle = 0; Triangle < TriangleCount; Triangle++)
+	{
+		const unsigned int* Corners = &Indices[Triangle * 3];
+		TriangleScores[Triangle] = VertexScores[Corners[0]] + VertexScores[Corners[1]] + VertexScores[Corners[2]];
+		if (TriangleScores[Triangle] > TriangleScores[Best])
+		{
+			Best = Triangle;
+		}
+	}
+
+	std::vector<unsigned int> Result(TriangleCount * 3);
+	unsigned int Cache[CacheSize + 3];
+	unsigned int NextCache[CacheSize + 3];
+	unsigned int CacheCount = 0;
+	unsigned int Cursor = 0;
+
+	for (unsigned int Output = 0; Output < TriangleCount; Output++)
+	{
+		//nothing in the cache has triangles left, restart from the next unemitted one
+		if (Best == 0xffffffff)
+		{
+			while (Emitted[Cursor])
+			{
+				Cursor++;
+			}
+			Best = Cursor;
+		}
+
+		const unsigned int* Corners = &Indices[Best * 3];
+		Emitted[Best] = 1;
+
+		unsigned int NextCount = 0;
+		for (unsigned int Corner = 0; Corner < 3; Corner++)
+		{
+			unsigned int Vertex = Corners[Corner];
+			Result[Output * 3 + Corner] = Vertex;
+
+			unsigned int* List = &Triangles[Offsets[Vertex]];
+			for (unsigned int ListIter = 0; ListIter < Live[Vertex]; ListIter++)
+			{
+				if (List[ListIter] == Best)
+				{
+					List[ListIter] = List[--Live[Vertex]];
+					break;
+				}
+			}
+
+			if (CachePositions[Vertex] != -2)
+			{
+				NextCache[NextCount++] = Vertex;
+				CachePositions[Vertex] = -2;
+			}
+		}
+
+		//the emitted triangle moves to the front, the rest shuffle back in order
+		for (unsigned int CacheIter = 0; CacheIter < CacheCount; CacheIter++)
+		{
+			if (CachePositions[Cache[CacheIter]] != -2)
+			{
+				NextCache[NextCount++] = Cache[CacheIter];
+			}
+		}
+
+		for (unsigned int CacheIter = 0; CacheIter < NextCount; CacheIter++)
+		{
+			unsigned int Vertex = NextCache[CacheIter];
+			CachePositions[Vertex] = (CacheIter < CacheSize) ? (int)CacheIter : -1;
+			VertexScores[Vertex] = ScoreVertex(Vertex);
+		}
+
+		//only triangles around vertices that moved can change score
+		Best = 0xffffffff;
+		float BestScore = -1.0f;
+		for (unsigned int CacheIter = 0; CacheIter < NextCount; CacheIter++)
+		{
+			unsigned int Vertex = NextCache[CacheIter];
+			const unsigned int* List = &Triangles[Offsets[Vertex]];
+
+			for (unsigned int ListIter = 0; ListIter < Live[Vertex]; ListIter++)
+			{
+				unsigned int Triangle = List[ListIter];
+				const unsigned int* Other = &Indices[Triangle * 3];
+				TriangleScores[Triangle] = VertexScores[Other[0]] + VertexScores[Other[1]] + VertexScores[Other[2]];
+
+				if (TriangleScores[Triangle] > BestScore)
+				{
+					BestScore = TriangleScores[Triangle];
+					Best = Triangle;
+				}
+			}
+		}
+
+		CacheCount = std::min(NextCount, CacheSize);
+		memcpy(Cache, NextCache, sizeof(unsigned int) * CacheCount);
+	}
+
+	Indices.swap(Result);
+}
+
+//sorts triangle clusters of a cache optimized index buffer so the ones
+//facing out from the mesh centre are drawn first and hide the rest (Sander,
+//Nehab and Barczak). the buffer is cut wherever the FIFO cache starts cold,
+//and those runs are cut again wherever their running ACMR is within
+//Threshold times the run's own ACMR, so reordering the clusters raises ACMR
+//by about Threshold at most. 1.05 allows 5%
+template<typename VertexType, typename ScalarType>
+void OptimizeOverdraw(std::vector<unsigned int>& Indices, const std::vector<VertexType>& Vertices,
+	unsigned int PositionOffset, float Threshold, unsigned int CacheSize = 16)
+{
+	unsigned int TriangleCount = Indices.size() / 3;
+	unsigned int VertexCount = Vertices.size();
+
+	if (TriangleCount < 2 || VertexCount == 0)
+	{
+		return;
+	}
+
+	std::vector<unsigned int> Timestamps(VertexCount, 0);
+	unsigned int Time = CacheSize + 1;
+
+	auto CountMisses = [&](unsigned int Triangle) -> unsigned int
+	{
+		unsigned int Misses = 0;
+		for (unsigned int Corner = 0; Corner < 3; Corner++)
+		{
+			unsigned int Vertex = Indices[Triangle * 3 + Corner];
+			if (Time - Timestamps[Vertex] > CacheSize)
+			{
+				Timestamps[Vertex] = Time++;
+				Misses++;
+			}
+		}
+		return Misses;
+	};
+
+	//hard boundaries, where a triangle misses on every corner
+	std::vector<unsigned int> HardClusters;
+	for (unsigned int Triangle = 0; Triangle < TriangleCount; Triangle++)
+	{
+		if (CountMisses(Triangle) == 3 || Triangle == 0)
+		{
+			HardClusters.push_back(Triangle);
+		}
+	}
+	HardClusters.push_back(TriangleCount);
+
+	//soft boundaries inside each hard cluster, each cluster starts with a flushed cache
+	std::vector<unsigned int> Clusters;
+	for (unsigned int HardIter = 0; HardIter + 1 < HardClusters.size(); HardIter++)
+	{
+		unsigned int First = HardClusters[HardIter];
+		unsigned int Last = HardClusters[HardIter + 1];
+
+		Time += CacheSize + 1;
+		unsigned int ClusterMisses = 0;
+		for (unsigned int Triangle = First; Triangle < Last; Triangle++)
+		{
+			ClusterMisses += CountMisses(Triangle);
+		}
+		float ClusterThreshold = Threshold * (float)ClusterMisses / (float)(Last - First);
+
+		Time += CacheSize + 1;
+		unsigned int Start = First;
+		unsigned int Misses = 0;
+		Clusters.push_back(First);
+
+		for (unsigned int Triangle = First; Triangle < Last; Triangle++)
+		{
+			Misses += CountMisses(Triangle);
+
+			if (Triangle + 1 < Last && (float)Misses / (float)(Triangle + 1 - Start) <= ClusterThreshold)
+			{
+				Clusters.push_back(Triangle + 1);
+				Start = Triangle + 1;
+				Misses = 0;
+				Time += CacheSize + 1;
+			}
+		}
+	}
+
+	unsigned int ClusterCount = Clusters.size();
+	Clusters.push_back(TriangleCount);
+
+	//area weighted centroid and normal of each cluster
+	std::vector<ScalarType> ClusterData(ClusterCount * 7, 0);
+	ScalarType MeshCentroid[3] = { 0, 0, 0 };
+	ScalarType MeshArea = 0;
+
+	for (unsigned int ClusterIter = 0; ClusterIter < ClusterCount; ClusterIter++)
+	{
+		ScalarType* Data = &ClusterData[ClusterIter * 7];
+
+		for (unsigned int Triangle = Clusters[ClusterIter]; Triangle < Clusters[ClusterIter + 1]; Triangle++)
+		{
+			const ScalarType* P[3];
+			for (unsigned int Corner = 0; Corner < 3; Corner++)
+			{
+				P[Corner] = (const ScalarType*)((const unsigned char*)&Vertices[Indices[Triangle * 3 + Corner]] + PositionOffset);
+			}
+
+			ScalarType E1[3] = { P[1][0] - P[0][0], P[1][1] - P[0][1], P[1][2] - P[0][2] };
+			ScalarType E2[3] = { P[2][0] - P[0][0], P[2][1] - P[0][1], P[2][2] - P[0][2] };
+			ScalarType Normal[3] =
+			{
+				E1[1] * E2[2] - E1[2] * E2[1],
+				E1[2] * E2[0] - E1[0] * E2[2],
+				E1[0] * E2[1] - E1[1] * E2[0]
+			};
+			ScalarType Area = sqrt(Normal[0] * Normal[0] + Normal[1] * Normal[1] + Normal[2] * Normal[2]);
+
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				ScalarType Centre = (P[0][Component] + P[1][Component] + P[2][Component]) / 3;
+				Data[Component] += Centre * Area;
+				Data[3 + Component] += Normal[Component];
+				MeshCentroid[Component] += Centre * Area;
+			}
+			Data[6] += Area;
+			MeshArea += Area;
+		}
+	}
+
+	if (MeshArea > 0)
+	{
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			MeshCentroid[Component] /= MeshArea;
+		}
+	}
+
+	std::vector<float> SortKeys(ClusterCount);
+	std::vector<unsigned int> Order(ClusterCount);
+
+	for (unsigned int ClusterIter = 0; ClusterIter < ClusterCount; ClusterIter++)
+	{
+		const ScalarType* Data = &ClusterData[ClusterIter * 7];
+		ScalarType Length = sqrt(Data[3] * Data[3] + Data[4] * Data[4] + Data[5] * Data[5]);
+		ScalarType Dot = 0;
+
+		if (Data[6] > 0 && Length > 0)
+		{
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				Dot += (Data[Component] / Data[6] - MeshCentroid[Component]) * Data[3 + Component];
+			}
+			Dot /= Length;
+		}
+
+		SortKeys[ClusterIter] = (float)Dot;
+		Order[ClusterIter] = ClusterIter;
+	}
+
+	//clusters further out along their own normal occlude more, so they go first
+	std::stable_sort(Order.begin(), Order.end(), [&](unsigned int A, unsigned int B)
+	{
+		return SortKeys[A] > SortKeys[B];
+	});
+
+	std::vector<unsigned int> Result;
+	Result.reserve(TriangleCount * 3);
+	for (unsigned int OrderIter = 0; OrderIter < ClusterCount; OrderIter++)
+	{
+		unsigned int ClusterIter = Order[OrderIter];
+		Result.insert(Result.end(), Indices.begin() + Clusters[ClusterIter] * 3, Indices.begin() + Clusters[ClusterIter + 1] * 3);
+	}
+
+	Indices.swap(Result);
+}
+
+//renumbers vertices in the order the index buffer first reaches them so
+//vertex fetch walks memory forwards. Remap receives old -> new indices
+//(0xffffffff for unused vertices) for use with RemapVertexStream, and the
+//new vertex count is returned
+inline unsigned int OptimizeVertexFetchRemap(std::vector<unsigned int>& Indices, unsigned int VertexCount, std::vector<unsigned int>& Remap)
+{
+	Remap.assign(VertexCount, 0xffffffff);
+	unsigned int NextVertex = 0;
+
+	for (unsigned int IndexIter = 0; IndexIter < Indices.size(); IndexIter++)
+	{
+		unsigned int& Index = Indices[IndexIter];
+		if (Remap[Index] == 0xffffffff)
+		{
+			Remap[Index] = NextVertex++;
+		}
+		Index = Remap[Index];
+	}
+
+	return NextVertex;
+}
+
+//moves each vertex's run of ElementsPerVertex elements to its remapped slot
+//and drops unused vertices
+template<typename ElementType>
+void RemapVertexStream(std::vector<ElementType>& Stream, unsigned int ElementsPerVertex,
+	const std::vector<unsigned int>& Remap, unsigned int NewVertexCount)
+{
+	if (Stream.empty() || ElementsPerVertex == 0)
+	{
+		return;
+	}
+
+	std::vector<ElementType> Result(NewVertexCount * ElementsPerVertex);
+	unsigned int VertexCount = std::min((unsigned int)Remap.size(), (unsigned int)(Stream.size() / ElementsPerVertex));
+
+	for (unsigned int Vertex = 0; Vertex < VertexCount; Vertex++)
+	{
+		if (Remap[Vertex] != 0xffffffff)
+		{
+			std::copy(Stream.begin() + Vertex * ElementsPerVertex, Stream.begin() + (Vertex + 1) * ElementsPerVertex,
+				Result.begin() + Remap[Vertex] * ElementsPerVertex);
+		}
+	}
+
+	Stream.swap(Result);
+}
+
+//builds Stream anew from the old vertex each new one came from, so one old
+//vertex may be copied into several places
+template<typename ElementType>
+void GatherVertexStream(std::vector<ElementType>& Stream, unsigned int ElementsPerVertex, const std::vector<unsigned int>& VertexMap)
+{
+	if (Stream.empty() || ElementsPerVertex == 0)
+	{
+		return;
+	}
+
+	std::vector<ElementType> Result(VertexMap.size() * ElementsPerVertex);
+	for (unsigned int Vertex = 0; Vertex < VertexMap.size(); Vertex++)
+	{
+		std::copy(Stream.begin() + VertexMap[Vertex] * ElementsPerVertex, Stream.begin() + (VertexMap[Vertex] + 1) * ElementsPerVertex,
+			Result.begin() + Vertex * ElementsPerVertex);
+	}
+
+	Stream.swap(Result);
+}
+
+//a run of triangles drawn with indices relative to VertexOffset
+struct TIndexRange
+{
+	unsigned int IndexOffset;
+	unsigned int IndexCount;
+	unsigned int VertexOffset;
+	unsigned int VertexCount;
+};
+
+//cuts Indices into runs of whole triangles that each reach at most MaxVertices
+//vertices, keeping the triangle order. every run gets its own copy of the
+//vertices it uses, laid out one run after another: VertexMap receives the old
+//vertex behind each new one and ShortIndices the 16 bit indices relative to
+//their run's VertexOffset. MaxVertices must be 3 to 65536
+inline void SplitIndexRanges(const std::vector<unsigned int>& Indices, unsigned int VertexCount, unsigned int MaxVertices,
+	std::vector<TIndexRange>& Ranges, std::vector<unsigned int>& VertexMap, std::vector<unsigned short>& ShortIndices)
+{
+	Ranges.clear();
+	VertexMap.clear();
+	ShortIndices.resize(Indices.size());
+
+	//Stamp marks the vertices the current run already holds
+	std::vector<unsigned int> Stamp(VertexCount, 0xffffffff);
+	std::vector<unsigned int> Local(VertexCount);
+	TIndexRange Range = { 0, 0, 0, 0 };
+
+	for (unsigned int Triangle = 0; Triangle < Indices.size() / 3; Triangle++)
+	{
+		const unsigned int* Corners = &Indices[Triangle * 3];
+		unsigned int Added = 0;
+		for (unsigned int Corner = 0; Corner < 3; Corner++)
+		{
+			bool Repeat = (Corner > 0 && Corners[Corner] == Corners[0]) || (Corner > 1 && Corners[Corner] == Corners[1]);
+			Added += (Stamp[Corners[Corner]] != Ranges.size() && !Repeat) ? 1 : 0;
+		}
+
+		if (Range.VertexCount + Added > MaxVertices)
+		{
+			Ranges.push_back(Range);
+			Range.IndexOffset = Triangle * 3;
+			Range.IndexCount = 0;
+			Range.VertexOffset = VertexMap.size();
+			Range.VertexCount = 0;
+		}
+
+		for (unsigned int Corner = 0; Corner < 3; Corner++)
+		{
+			unsigned int Vertex = Corners[Corner];
+			if (Stamp[Vertex] != Ranges.size())
+			{
+				Stamp[Vertex] = Ranges.size();
+				Local[Vertex] = Range.VertexCount++;
+				VertexMap.push_back(Vertex);
+			}
+			ShortIndices[Triangle * 3 + Corner] = (unsigned short)Local[Vertex];
+		}
+		Range.IndexCount += 3;
+	}
+
+	if (Range.IndexCount > 0)
+	{
+		Ranges.push_back(Range);
+	}
+}
+
+//index buffer codec for cache optimized triangle lists. each triangle takes
+//one code byte, and usually nothing else, from a 16 entry FIFO of recent edges,
+//a 16 entry FIFO of recent vertices and a counter of the next unseen vertex,
+//which is what OptimizeVertexFetchRemap leaves behind. anything else is a
+//zigzag varint delta from the last such vertex. code byte layout:
+//  bits 7-6  which corner starts the shared edge, 3 when there is none
+//  bits 5-2  edge FIFO slot, or with no edge bit 2+n set when corner n is the next vertex
+//  bits 1-0  with an edge: 0 next vertex, 1 vertex FIFO slot in an extra byte,
+//            2 varint, 3 the newest vertex FIFO entry
+//triangles come back exactly as they went in, corner order included
+enum TIndexCodec
+{
+	TIndexCodecVersion = 1,
+	TIndexCodecNoEdge = 3,
+	TIndexCodecNext = 0,
+	TIndexCodecCache = 1,
+	TIndexCodecDelta = 2,
+	TIndexCodecNewest = 3
+};
+
+inline void WriteIndexDelta(std::vector<unsigned char>& Data, unsigned int Index, unsigned int& Last)
+{
+	int Delta = (int)(Index - Last);
+	unsigned int Zigzag = ((unsigned int)Delta << 1) ^ (unsigned int)(Delta >> 31);
+	Last = Index;
+
+	while (Zigzag >= 0x80)
+	{
+		Data.push_back((unsigned char)(Zigzag | 0x80));
+		Zigzag >>= 7;
+	}
+	Data.push_back((unsigned char)Zigzag);
+}
+
+inline bool ReadIndexDelta(const unsigned char*& Data, const unsigned char* End, unsigned int& Last)
+{
+	unsigned int Zigzag = 0;
+	for (unsigned int Shift = 0; Shift < 35; Shift += 7)
+	{
+		if (Data == End)
+		{
+			return false;
+		}
+
+		unsigned char Byte = *Data++;
+		Zigzag |= (unsigned int)(Byte & 0x7f) << Shift;
+		if ((Byte & 0x80) == 0)
+		{
+			Last += (Zigzag >> 1) ^ (0u - (Zigzag & 1));
+			return true;
+		}
+	}
+	return false;
+}
+
+//encodes IndexCount indices, a multiple of 3, into Encoded
+template<typename IndexType>
+void EncodeIndexBuffer(const IndexType* Indices, unsigned int IndexCount, std::vector<unsigned char>& Encoded)
+{
+	unsigned int TriangleCount = IndexCount / 3;
+	unsigned int EdgeFIFO[16][2];
+	unsigned int VertexFIFO[16];
+	unsigned int EdgeOffset = 0, VertexOffset = 0;
+	unsigned int Next = 0, Last = 0;
+	std::vector<unsigned char> Extra;
+
+	memset(EdgeFIFO, 0xff, sizeof(EdgeFIFO));
+	memset(VertexFIFO, 0xff, sizeof(VertexFIFO));
+	Encoded.assign(1 + TriangleCount, 0);
+	Encoded[0] = TIndexCodecVersion;
+
+	for (unsigned int Triangle = 0; Triangle < TriangleCount; Triangle++)
+	{
+		unsigned int Corners[3] = { Indices[Triangle * 3], Indices[Triangle * 3 + 1], Indices[Triangle * 3 + 2] };
+		unsigned int Rotation = TIndexCodecNoEdge, Slot = 0;
+
+		//adjacent triangles walk a shared edge the other way, which is how they are pushed
+		for (unsigned int EdgeIter = 0; EdgeIter < 16 && Rotation == TIndexCodecNoEdge; EdgeIter++)
+		{
+			const unsigned int* Edge = EdgeFIFO[(EdgeOffset - 1 - EdgeIter) & 15];
+			for (unsigned int Corner = 0; Corner < 3; Corner++)
+			{
+				if (Edge[0] == Corners[Corner] && Edge[1] == Corners[(Corner + 1) % 3])
+				{
+					Rotation = Corner;
+					Slot = EdgeIter;
+					break;
+				}
+			}
+		}
+
+		unsigned char Code = 0;
+		if (Rotation != TIndexCodecNoEdge)
+		{
+			unsigned int A = Corners[Rotation], B = Corners[(Rotation + 1) % 3], C = Corners[(Rotation + 2) % 3];
+			unsigned int Cached = 16;
+			for (unsigned int VertexIter = 0; VertexIter < 16 && Cached == 16; VertexIter++)
+			{
+				Cached = (VertexFIFO[(VertexOffset - 1 - VertexIter) & 15] == C) ? VertexIter : 16;
+			}
+
+			unsigned int Third = TIndexCodecDelta;
+			if (C == Next)
+			{
+				Third = TIndexCodecNext;
+				Next++;
+			}
+			else if (Cached == 0)
+			{
+				Third = TIndexCodecNewest;
+			}
+			else if (Cached < 16)
+			{
+				Third = TIndexCodecCache;
+				Extra.push_back((unsigned char)Cached);
+			}
+			else
+			{
+				WriteIndexDelta(Extra, C, Last);
+			}
+			Code = (unsigned char)((Rotation << 6) | (Slot << 2) | Third);
+
+			if (Third != TIndexCodecNewest && Third != TIndexCodecCache)
+			{
+				VertexFIFO[VertexOffset++ & 15] = C;
+			}
+			EdgeFIFO[EdgeOffset & 15][0] = C;
+			EdgeFIFO[EdgeOffset++ & 15][1] = B;
+			EdgeFIFO[EdgeOffset & 15][0] = A;
+			EdgeFIFO[EdgeOffset++ & 15][1] = C;
+		}
+
+		else
+		{
+			unsigned int Flags = 0;
+			for (unsigned int Corner = 0; Corner < 3; Corner++)
+			{
+				if (Corners[Corner] == Next)
+				{
+					Flags |= 1 << Corner;
+					Next++;
+				}
+				else
+				{
+					WriteIndexDelta(Extra, Corners[Corner], Last);
+				}
+				VertexFIFO[VertexOffset++ & 15] = Corners[Corner];
+			}
+			Code = (unsigned char)((TIndexCodecNoEdge << 6) | (Flags << 2));
+
+			for (unsigned int Corner = 0; Corner < 3; Corner++)
+			{
+				EdgeFIFO[EdgeOffset & 15][0] = Corners[(Corner + 1) % 3];
+				EdgeFIFO[EdgeOffset++ & 15][1] = Corners[Corner];
+			}
+		}
+		Encoded[1 + Triangle] = Code;
+	}
+
+	Encoded.insert(Encoded.end(), Extra.begin(), Extra.end());
+}
+
+//decodes EncodeIndexBuffer's output back into IndexCount indices. returns
+//false when the data is cut short or from another codec version
+template<typename IndexType>
+bool DecodeIndexBuffer(const unsigned char* Data, size_t Size, IndexType* Indices, unsigned int IndexCount)
+{
+	unsigned int TriangleCount = IndexCount / 3;
+	if (Size < 1 + (size_t)TriangleCount || Data[0] != TIndexCodecVersion)
+	{
+		return false;
+	}
+
+	const unsigned char* Codes = Data + 1;
+	const unsigned char* Extra = Codes + TriangleCount;
+	const unsigned char* End = Data + Size;
+	unsigned int EdgeFIFO[16][2];
+	unsigned int VertexFIFO[16];
+	unsigned int EdgeOffset = 0, VertexOffset = 0;
+	unsigned int Next = 0, Last = 0;
+
+	//corner after and before each rotation, to keep % out of the loop
+	const unsigned int After[3] = { 1, 2, 0 };
+	const unsigned int Before[3] = { 2, 0, 1 };
+
+	memset(EdgeFIFO, 0, sizeof(EdgeFIFO));
+	memset(VertexFIFO, 0, sizeof(VertexFIFO));
+
+	for (unsigned int Triangle = 0; Triangle < TriangleCount; Triangle++)
+	{
+		unsigned int Code = Codes[Triangle];
+		unsigned int Rotation = Code >> 6;
+		IndexType* Corners = Indices + Triangle * 3;
+
+		if (Rotation != TIndexCodecNoEdge)
+		{
+			const unsigned int* Edge = EdgeFIFO[(EdgeOffset - 1 - ((Code >> 2) & 15)) & 15];
+			unsigned int A = Edge[0], B = Edge[1], C;
+
+			switch (Code & 3)
+			{
+				case TIndexCodecNext:
+					C = Next++;
+					VertexFIFO[VertexOffset++ & 15] = C;
+					break;
+
+				case TIndexCodecNewest:
+					C = VertexFIFO[(VertexOffset - 1) & 15];
+					break;
+
+				case TIndexCodecCache:
+					if (Extra == End)
+					{
+						return false;
+					}
+					C = VertexFIFO[(VertexOffset - 1 - (*Extra++ & 15)) & 15];
+					break;
+
+				default:
+					if (!ReadIndexDelta(Extra, End, Last))
+					{
+						return false;
+					}
+					C = Last;
+					VertexFIFO[VertexOffset++ & 15] = C;
+					break;
+			}
+
+			Corners[Rotation] = (IndexType)A;
+			Corners[After[Rotation]] = (IndexType)B;
+			Corners[Before[Rotation]] = (IndexType)C;
+
+			EdgeFIFO[EdgeOffset & 15][0] = C;
+			EdgeFIFO[EdgeOffset++ & 15][1] = B;
+			EdgeFIFO[EdgeOffset & 15][0] = A;
+			EdgeFIFO[EdgeOffset++ & 15][1] = C;
+		}
+
+		else
+		{
+			for (unsigned int Corner = 0; Corner < 3; Corner++)
+			{
+				unsigned int Vertex;
+				if (Code & (4 << Corner))
+				{
+					Vertex = Next++;
+				}
+				else
+				{
+					if (!ReadIndexDelta(Extra, End, Last))
+					{
+						return false;
+					}
+					Vertex = Last;
+				}
+				Corners[Corner] = (IndexType)Vertex;
+				VertexFIFO[VertexOffset++ & 15] = Vertex;
+			}
+
+			for (unsigned int Corner = 0; Corner < 3; Corner++)
+			{
+				EdgeFIFO[EdgeOffset & 15][0] = Corners[(Corner + 1) % 3];
+				EdgeFIFO[EdgeOffset++ & 15][1] = Corners[Corner];
+			}
+		}
+	}
+	return true;
+}
+
+//lossless vertex buffer codec. vertices are taken in blocks, and inside a
+//block every byte of the vertex becomes a plane of that byte across all the
+//block's vertices. each plane is delta encoded against the previous vertex,
+//zigzagged so small changes either way stay small, and packed in groups of 16
+//at 0, 2, 4 or 8 bits a value, chosen per group by a 2 bit header. the group
+//loops have a fixed 16 lane shape for the compiler to vectorize
+enum TVertexCodec
+{
+	TVertexCodecVersion = 1,
+	TVertexCodecGroup = 16,
+	TVertexCodecMaxBlock = 256
+};
+
+//vertices per block, sized so a block of one stream stays around 8KB
+inline unsigned int VertexCodecBlockSize(unsigned int Stride)
+{
+	unsigned int BlockSize = (8192 / std::max(Stride, 1u)) & ~(TVertexCodecGroup - 1);
+	return std::min(std::max(BlockSize, (unsigned int)TVertexCodecGroup), (unsigned int)TVertexCodecMaxBlock);
+}
+
+inline void EncodeVertexBuffer(const unsigned char* Vertices, unsigned int Count, unsigned int Stride, std::vector<unsigned char>& Encoded)
+{
+	const unsigned int BitWidths[4] = { 0, 2, 4, 8 };
+	unsigned int BlockSize = VertexCodecBlockSize(Stride);
+	std::vector<unsigned char> Last(Stride, 0);
+	unsigned char Deltas[TVertexCodecMaxBlock];
+
+	Encoded.assign(1, (unsigned char)TVertexCodecVersion);
+
+	for (unsigned int BlockStart = 0; BlockStart < Count; BlockStart += BlockSize)
+	{
+		unsigned int BlockCount = std::min(BlockSize, Count - BlockStart);
+		unsigned int GroupCount = (BlockCount + TVertexCodecGroup - 1) / TVertexCodecGroup;
+
+		for (unsigned int Byte = 0; Byte < Stride; Byte++)
+		{
+			unsigned char Previous = Last[Byte];
+			memset(Deltas, 0, sizeof(Deltas));
+			for (unsigned int Vertex = 0; Vertex < BlockCount; Vertex++)
+			{
+				unsigned char Value = Vertices[(BlockStart + Vertex) * Stride + Byte];
+				unsigned char Delta = (unsigned char)(Value - Previous);
+				Deltas[Vertex] = (unsigned char)((Delta << 1) ^ (unsigned char)(0 - (Delta >> 7)));
+				Previous = Value;
+			}
+			Last[Byte] = Previous;
+
+			//headers for the plane come first, 4 groups to a byte
+			size_t Header = Encoded.size();
+			Encoded.resize(Encoded.size() + (GroupCount + 3) / 4, 0);
+
+			for (unsigned int Group = 0; Group < GroupCount; Group++)
+			{
+				const unsigned char* Values = Deltas + Group * TVertexCodecGroup;
+				unsigned char Largest = 0;
+				for (unsigned int Lane = 0; Lane < TVertexCodecGroup; Lane++)
+				{
+					Largest |= Values[Lane];
+				}
+
+				unsigned int Width = (Largest == 0) ? 0 : (Largest < 4) ? 1 : (Largest < 16) ? 2 : 3;
+				unsigned int Bits = BitWidths[Width];
+				Encoded[Header + Group / 4] |= (unsigned char)(Width << ((Group % 4) * 2));
+
+				size_t Packed = Encoded.size();
+				Encoded.resize(Encoded.size() + Bits * TVertexCodecGroup / 8, 0);
+				for (unsigned int Lane = 0; Lane < TVertexCodecGroup && Bits > 0; Lane++)
+				{
+					unsigned int Bit = Lane * Bits;
+					Encoded[Packed + Bit / 8] |= (unsigned char)(Values[Lane] << (Bit % 8));
+				}
+			}
+		}
+	}
+}
+
+//decodes EncodeVertexBuffer's output back into Count vertices of Stride
+//bytes. returns false when the data is cut short or from another codec version
+inline bool DecodeVertexBuffer(const unsigned char* Data, size_t Size, unsigned char* Vertices, unsigned int Count, unsigned int Stride)
+{
+	if (Size < 1 || Data[0] != TVertexCodecVersion)
+	{
+		return false;
+	}
+
+	const unsigned char* Read = Data + 1;
+	const unsigned char* End = Data + Size;
+	unsigned int BlockSize = VertexCodecBlockSize(Stride);
+	std::vector<unsigned char> Last(Stride, 0);
+	unsigned char Deltas[TVertexCodecMaxBlock];
+
+	for (unsigned int BlockStart = 0; BlockStart < Count; BlockStart += BlockSize)
+	{
+		unsigned int BlockCount = std::min(BlockSize, Count - BlockStart);
+		unsigned int GroupCount = (BlockCount + TVertexCodecGroup - 1) / TVertexCodecGroup;
+		unsigned char* Block = Vertices + (size_t)BlockStart * Stride;
+
+		for (unsigned int Byte = 0; Byte < Stride; Byte++)
+		{
+			const unsigned char* Header = Read;
+			Read += (GroupCount + 3) / 4;
+			if (Read > End)
+			{
+				return false;
+			}
+
+			for (unsigned int Group = 0; Group < GroupCount; Group++)
+			{
+				unsigned int Width = (Header[Group / 4] >> ((Group % 4) * 2)) & 3;
+				unsigned char* Values = Deltas + Group * TVertexCodecGroup;
+
+				//Width 0, 1, 2, 3 packs 0, 4, 8, 16 bytes
+				unsigned int Bytes = (Width != 0) ? (2u << Width) : 0;
+				if (Read + Bytes > End)
+				{
+					return false;
+				}
+
+				switch (Width)
+				{
+					case 0:
+						memset(Values, 0, TVertexCodecGroup);
+						break;
+
+					case 1:
+						for (unsigned int Lane = 0; Lane < TVertexCodecGroup; Lane++)
+						{
+							Values[Lane] = (Read[Lane >> 2] >> ((Lane & 3) * 2)) & 3;
+						}
+						break;
+
+					case 2:
+						for (unsigned int Lane = 0; Lane < TVertexCodecGroup; Lane++)
+						{
+							Values[Lane] = (Read[Lane >> 1] >> ((Lane & 1) * 4)) & 15;
+						}
+						break;
+
+					default:
+						memcpy(Values, Read, TVertexCodecGroup);
+						break;
+				}
+				Read += Bytes;
+			}
+
+			//undo the zigzag across the whole plane, then run the deltas forward
+			for (unsigned int Vertex = 0; Vertex < GroupCount * TVertexCodecGroup; Vertex++)
+			{
+				Deltas[Vertex] = (unsigned char)((Deltas[Vertex] >> 1) ^ (unsigned char)(0 - (Deltas[Vertex] & 1)));
+			}
+
+			unsigned char Previous = Last[Byte];
+			for (unsigned int Vertex = 0; Vertex < BlockCount; Vertex++)
+			{
+				Previous = (unsigned char)(Previous + Deltas[Vertex]);
+				Block[Vertex * Stride + Byte] = Previous;
+			}
+			Last[Byte] = Previous;
+		}
+	}
+	return true;
+}
+
+//symmetric quadric of squared distances to a set of planes, with the total
+//plane weight kept so the error can be read back as a mean
+struct TQuadric
+{
+	TQuadric() : A00(0), A11(0), A22(0), A10(0), A20(0), A21(0), B0(0), B1(0), B2(0), C(0), Weight(0){}
+
+	//plane A x + B y + C z + D = 0 with a unit normal
+	void AddPlane(double A, double B, double PlaneC, double D, double PlaneWeight)
+	{
+		A00 += A * A * PlaneWeight;
+		A11 += B * B * PlaneWeight;
+		A22 += PlaneC * PlaneC * PlaneWeight;
+		A10 += B * A * PlaneWeight;
+		A20 += PlaneC * A * PlaneWeight;
+		A21 += PlaneC * B * PlaneWeight;
+		B0 += A * D * PlaneWeight;
+		B1 += B * D * PlaneWeight;
+		B2 += PlaneC * D * PlaneWeight;
+		C += D * D * PlaneWeight;
+		Weight += PlaneWeight;
+	}
+
+	void Add(const TQuadric& Other)
+	{
+		A00 += Other.A00;
+		A11 += Other.A11;
+		A22 += Other.A22;
+		A10 += Other.A10;
+		A20 += Other.A20;
+		A21 += Other.A21;
+		B0 += Other.B0;
+		B1 += Other.B1;
+		B2 += Other.B2;
+		C += Other.C;
+		Weight += Other.Weight;
+	}
+
+	//weighted mean squared distance from Point to the planes
+	double Error(const double* Point) const
+	{
+		double X = Point[0], Y = Point[1], Z = Point[2];
+		double Sum = A00 * X * X + A11 * Y * Y + A22 * Z * Z
+			+ 2 * (A10 * X * Y + A20 * X * Z + A21 * Y * Z)
+			+ 2 * (B0 * X + B1 * Y + B2 * Z) + C;
+		return (Weight > 0) ? fabs(Sum) / Weight : 0;
+	}
+
+	double A00, A11, A22, A10, A20, A21;
+	double B0, B1, B2;
+	double C;
+	double Weight;
+};
+
+//quadric edge collapse simplifier (Garland and Heckbert). every collapse
+//moves one vertex onto a neighbour that already exists, so Result indexes the
+//same Vertices as Indices and LODs can share one vertex buffer.
+//vertices sharing a position but not attributes are attribute seams (uv,
+//normal, colour or skin): a seam vertex may only slide along its seam and
+//takes its twin along with it, open border vertices only slide along the
+//border, and anything more tangled is locked. collapses are picked in passes,
+//cheapest first with each vertex touched once per pass, until Result is down
+//to TargetIndexCount or nothing under TargetError is left. TargetError and
+//the returned error are distances relative to the mesh's largest extent.
+//plane quadrics and collapse costs are found with ParallelFor
+template<typename VertexType, typename ScalarType>
+float SimplifyMesh(const std::vector<unsigned int>& Indices, const std::vector<VertexType>& Vertices,
+	unsigned int PositionOffset, unsigned int TargetIndexCount, float TargetError,
+	std::vector<unsigned int>& Result, unsigned int ThreadCount = 0)
+{
+	enum TVertexKind
+	{
+		TMANIFOLD,
+		TBORDER,
+		TSEAM,
+		TLOCKED
+	};
+
+	const unsigned int Missing = 0xffffffff;
+	const unsigned int BlockSize = 1024;
+	unsigned int VertexCount = Vertices.size();
+
+	Result = Indices;
+	if (VertexCount == 0 || Result.size() < 3 || Result.size() <= TargetIndexCount)
+	{
+		return 0;
+	}
+
+	//positions are scaled into the unit cube so errors are relative to the mesh size
+	std::vector<double> Positions(VertexCount * 3);
+	double Min[3] = { 0, 0, 0 };
+	double Extent = 0;
+
+	for (unsigned int Vertex = 0; Vertex < VertexCount; Vertex++)
+	{
+		const ScalarType* Position = (const ScalarType*)((const unsigned char*)&Vertices[Vertex] + PositionOffset);
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Positions[Vertex * 3 + Component] = (double)Position[Component];
+			Min[Component] = (Vertex == 0) ? Positions[Component] : std::min(Min[Component], Positions[Vertex * 3 + Component]);
+		}
+	}
+
+	for (unsigned int Vertex = 0; Vertex < VertexCount; Vertex++)
+	{
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Extent = std::max(Extent, Positions[Vertex * 3 + Component] - Min[Component]);
+		}
+	}
+
+	double Scale = (Extent > 0) ? 1 / Extent : 1;
+	for (unsigned int Vertex = 0; Vertex < VertexCount; Vertex++)
+	{
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Positions[Vertex * 3 + Component] = (Positions[Vertex * 3 + Component] - Min[Component]) * Scale;
+		}
+	}
+
+	//Remap is the lowest vertex at the same position, Wedge links every vertex at a position in a ring
+	std::vector<unsigned int> Remap(VertexCount), Wedge(VertexCount);
+	{
+		std::vector<unsigned int> Order(VertexCount);
+		for (unsigned int Vertex = 0; Vertex < VertexCount; Vertex++)
+		{
+			Order[Vertex] = Vertex;
+		}
+
+		const double* P = Positions.data();
+		std::sort(Order.begin(), Order.end(), [P](unsigned int A, unsigned int B)
+		{
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				if (P[A * 3 + Component] != P[B * 3 + Component])
+				{
+					return P[A * 3 + Component] < P[B * 3 + Component];
+				}
+			}
+			return A < B;
+		});
+
+		for (unsigned int First = 0, Last = 0; First < VertexCount; First = Last)
+		{
+			for (Last = First + 1; Last < VertexCount &&
+				memcmp(&P[Order[First] * 3], &P[Order[Last] * 3], sizeof(double) * 3) == 0; Last++);
+
+			for (unsigned int OrderIter = First; OrderIter < Last; OrderIter++)
+			{
+				Remap[Order[OrderIter]] = Order[First];
+				Wedge[Order[OrderIter]] = Order[(OrderIter + 1 < Last) ? OrderIter + 1 : First];
+			}
+		}
+	}
+
+	//outgoing half edges per vertex and corners per position, rebuilt every pass
+	std::vector<unsigned int> EdgeOffsets, EdgeCorners, PositionOffsets, PositionCorners;
+	auto BuildAdjacency = [&]()
+	{
+		BuildBuckets(Result.size(), VertexCount,
+			[&](unsigned int Corner) { return Result[Corner]; },
+			EdgeOffsets, EdgeCorners);
+		BuildBuckets(Result.size(), VertexCount,
+			[&](unsigned int Corner) { return Remap[Result[Corner]]; },
+			PositionOffsets, PositionCorners);
+	};
+
+	auto NextCorner = [](unsigned int Corner) -> unsigned int
+	{
+		return (Corner % 3 == 2) ? Corner - 2 : Corner + 1;
+	};
+
+	auto HasEdge = [&](unsigned int From, unsigned int To) -> bool
+	{
+		for (unsigned int EdgeIter = EdgeOffsets[From]; EdgeIter < EdgeOffsets[From + 1]; EdgeIter++)
+		{
+			if (Result[NextCorner(EdgeCorners[EdgeIter])] == To)
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	BuildAdjacency();
+
+	//an open edge has no twin running the other way between the same vertices.
+	//OpenIn and OpenOut hold the one open neighbour, or the vertex itself if there are several
+	std::vector<unsigned int> OpenIn(VertexCount, Missing), OpenOut(VertexCount, Missing);
+	for (unsigned int Vertex = 0; Vertex < VertexCount; Vertex++)
+	{
+		for (unsigned int EdgeIter = EdgeOffsets[Vertex]; EdgeIter < EdgeOffsets[Vertex + 1]; EdgeIter++)
+		{
+			unsigned int Target = Result[NextCorner(EdgeCorners[EdgeIter])];
+			if (!HasEdge(Target, Vertex))
+			{
+				OpenOut[Vertex] = (OpenOut[Vertex] == Missing) ? Target : Vertex;
+				OpenIn[Target] = (OpenIn[Target] == Missing) ? Vertex : Target;
+			}
+		}
+	}
+
+	auto SingleOpen = [&](unsigned int Vertex) -> bool
+	{
+		return OpenIn[Vertex] != Missing && OpenIn[Vertex] != Vertex &&
+			OpenOut[Vertex] != Missing && OpenOut[Vertex] != Vertex;
+	};
+
+	std::vector<unsigned char> Kinds(VertexCount, TLOCKED);
+	for (unsigned int Vertex = 0; Vertex < VertexCount; Vertex++)
+	{
+		unsigned int Twin = Wedge[Vertex];
+
+		if (Twin == Vertex)
+		{
+			if (OpenIn[Vertex] == Missing && OpenOut[Vertex] == Missing)
+			{
+				Kinds[Vertex] = TMANIFOLD;
+			}
+			else if (SingleOpen(Vertex))
+			{
+				Kinds[Vertex] = TBORDER;
+			}
+		}
+		else if (Wedge[Twin] == Vertex && SingleOpen(Vertex) && SingleOpen(Twin) &&
+			Remap[OpenOut[Vertex]] == Remap[OpenIn[Twin]] && Remap[OpenIn[Vertex]] == Remap[OpenOut[Twin]])
+		{
+			//two wedges whose open edges run along each other in opposite directions
+			Kinds[Vertex] = TSEAM;
+		}
+	}
+
+	//plane quadric of every triangle, gathered per position in triangle order
+	unsigned int TriangleCount = Result.size() / 3;
+	std::vector<TQuadric> Quadrics(VertexCount);
+	{
+		std::vector<TQuadric> TriangleQuadrics(TriangleCount);
+
+		ParallelFor((TriangleCount + BlockSize - 1) / BlockSize, ThreadCount, [&](unsigned int BlockIter)
+		{
+			unsigned int Last = std::min((BlockIter + 1) * BlockSize, TriangleCount);
+			for (unsigned int Triangle = BlockIter * BlockSize; Triangle < Last; Triangle++)
+			{
+				const double* P0 = &Positions[Result[Triangle * 3] * 3];
+				const double* P1 = &Positions[Result[Triangle * 3 + 1] * 3];
+				const double* P2 = &Positions[Result[Triangle * 3 + 2] * 3];
+
+				double E1[3] = { P1[0] - P0[0], P1[1] - P0[1], P1[2] - P0[2] };
+				double E2[3] = { P2[0] - P0[0], P2[1] - P0[1], P2[2] - P0[2] };
+				double Normal[3] = { E1[1] * E2[2] - E1[2] * E2[1], E1[2] * E2[0] - E1[0] * E2[2], E1[0] * E2[1] - E1[1] * E2[0] };
+				double Area = sqrt(Normal[0] * Normal[0] + Normal[1] * Normal[1] + Normal[2] * Normal[2]);
+
+				if (Area > 0)
+				{
+					Normal[0] /= Area;
+					Normal[1] /= Area;
+					Normal[2] /= Area;
+					TriangleQuadrics[Triangle].AddPlane(Normal[0], Normal[1], Normal[2],
+						-(Normal[0] * P0[0] + Normal[1] * P0[1] + Normal[2] * P0[2]), Area);
+				}
+			}
+		});
+
+		ParallelFor((VertexCount + BlockSize - 1) / BlockSize, ThreadCount, [&](unsigned int BlockIter)
+		{
+			unsigned int Last = std::min((BlockIter + 1) * BlockSize, VertexCount);
+			for (unsigned int Vertex = BlockIter * BlockSize; Vertex < Last; Vertex++)
+			{
+				for (unsigned int CornerIter = PositionOffsets[Vertex]; CornerIter < PositionOffsets[Vertex + 1]; CornerIter++)
+				{
+					Quadrics[Vertex].Add(TriangleQuadrics[PositionCorners[CornerIter] / 3]);
+				}
+			}
+		});
+
+		//open borders also get a steep plane through the edge so they keep their outline
+		const double BorderWeight = 10;
+		for (unsigned int Corner = 0; Corner < Result.size(); Corner++)
+		{
+			unsigned int From = Result[Corner];
+			unsigned int To = Result[NextCorner(Corner)];
+			if (Kinds[From] != TBORDER || Kinds[To] != TBORDER || OpenOut[From] != To)
+			{
+				continue;
+			}
+
+			const double* P0 = &Positions[From * 3];
+			const double* P1 = &Positions[To * 3];
+			const double* P2 = &Positions[Result[NextCorner(NextCorner(Corner))] * 3];
+
+			double Edge[3] = { P1[0] - P0[0], P1[1] - P0[1], P1[2] - P0[2] };
+			double E2[3] = { P2[0] - P0[0], P2[1] - P0[1], P2[2] - P0[2] };
+			double Normal[3] = { Edge[1] * E2[2] - Edge[2] * E2[1], Edge[2] * E2[0] - Edge[0] * E2[2], Edge[0] * E2[1] - Edge[1] * E2[0] };
+			double Plane[3] = { Edge[1] * Normal[2] - Edge[2] * Normal[1], Edge[2] * Normal[0] - Edge[0] * Normal[2], Edge[0] * Normal[1] - Edge[1] * Normal[0] };
+			double Length = sqrt(Plane[0] * Plane[0] + Plane[1] * Plane[1] + Plane[2] * Plane[2]);
+			double EdgeLength = Edge[0] * Edge[0] + Edge[1] * Edge[1] + Edge[2] * Edge[2];
+
+			if (Length > 0)
+			{
+				TQuadric BorderQuadric;
+				BorderQuadric.AddPlane(Plane[0] / Length, Plane[1] / Length, Plane[2] / Length,
+					-(Plane[0] * P0[0] + Plane[1] * P0[1] + Plane[2] * P0[2]) / Length, EdgeLength * BorderWeight);
+				Quadrics[Remap[From]].Add(BorderQuadric);
+				Quadrics[Remap[To]].Add(BorderQuadric);
+			}
+		}
+	}
+
+	struct TCollapse
+	{
+		unsigned int From;
+		unsigned int To;
+		float Cost;
+	};
+
+	double ErrorLimit = (double)TargetError * (double)TargetError;
+	double MaxError = 0;
+	std::vector<TCollapse> Collapses;
+	std::vector<unsigned int> CollapseRemap(VertexCount);
+	std::vector<unsigned char> Touched(VertexCount);
+
+	while (Result.size() > TargetIndexCount)
+	{
+		unsigned int CornerCount = Result.size();
+		Collapses.resize(CornerCount);
+
+		//cheapest allowed direction of every edge, each edge is looked at from one side only
+		ParallelFor((CornerCount + BlockSize - 1) / BlockSize, ThreadCount, [&](unsigned int BlockIter)
+		{
+			unsigned int Last = std::min((BlockIter + 1) * BlockSize, CornerCount);
+			for (unsigned int Corner = BlockIter * BlockSize; Corner < Last; Corner++)
+			{
+				TCollapse& Collapse = Collapses[Corner];
+				unsigned int A = Result[Corner];
+				unsigned int B = Result[NextCorner(Corner)];
+				bool Open = !HasEdge(B, A);
+				Collapse.Cost = -1;
+
+				if (!Open && Remap[A] > Remap[B])
+				{
+					continue;
+				}
+
+				for (unsigned int Direction = 0; Direction < 2; Direction++)
+				{
+					unsigned int From = Direction ? B : A;
+					unsigned int To = Direction ? A : B;
+					unsigned char Kind = Kinds[From];
+
+					bool Allowed = (Kind == TMANIFOLD) ||
+						((Kind == TBORDER || Kind == TSEAM) && Kinds[To] == Kind && Open);
+					if (!Allowed)
+					{
+						continue;
+					}
+
+					double Cost = Quadrics[Remap[From]].Error(&Positions[To * 3]);
+					if (Cost <= ErrorLimit && (Collapse.Cost < 0 || Cost < Collapse.Cost))
+					{
+						Collapse.From = From;
+						Collapse.To = To;
+						Collapse.Cost = (float)Cost;
+					}
+				}
+			}
+		});
+
+		Collapses.erase(std::remove_if(Collapses.begin(), Collapses.end(),
+			[](const TCollapse& Collapse) { return Collapse.Cost < 0; }), Collapses.end());
+		if (Collapses.empty())
+		{
+			break;
+		}
+
+		std::sort(Collapses.begin(), Collapses.end(), [](const TCollapse& A, const TCollapse& B)
+		{
+			return A.Cost < B.Cost;
+		});
+
+		for (unsigned int Vertex = 0; Vertex < VertexCount; Vertex++)
+		{
+			CollapseRemap[Vertex] = Vertex;
+		}
+		std::fill(Touched.begin(), Touched.end(), 0);
+
+		unsigned int Goal = (CornerCount - TargetIndexCount + 2) / 3;
+		unsigned int Removed = 0;
+		unsigned int Performed = 0;
+
+		for (unsigned int CollapseIter = 0; CollapseIter < Collapses.size() && Removed < Goal; CollapseIter++)
+		{
+			const TCollapse& Collapse = Collapses[CollapseIter];
+			unsigned int From = Collapse.From;
+			unsigned int To = Collapse.To;
+			unsigned int FromPosition = Remap[From];
+			unsigned int ToPosition = Remap[To];
+
+			if (Touched[FromPosition] || Touched[ToPosition])
+			{
+				continue;
+			}
+
+			unsigned int FromTwin = Wedge[From];
+			unsigned int ToTwin = Wedge[To];
+			if (Kinds[From] == TSEAM && !HasEdge(FromTwin, ToTwin) && !HasEdge(ToTwin, FromTwin))
+			{
+				continue;
+			}
+
+			//reject collapses that would fold a surrounding triangle over
+			bool Flips = false;
+			const double* Target = &Positions[To * 3];
+			for (unsigned int CornerIter = PositionOffsets[FromPosition]; CornerIter < PositionOffsets[FromPosition + 1] && !Flips; CornerIter++)
+			{
+				unsigned int Corner = PositionCorners[CornerIter];
+				unsigned int Next = NextCorner(Corner);
+				unsigned int Other = NextCorner(Next);
+				if (Remap[Result[Next]] == ToPosition || Remap[Result[Other]] == ToPosition)
+				{
+					continue;
+				}
+
+				const double* P0 = &Positions[Result[Corner] * 3];
+				const double* P1 = &Positions[Result[Next] * 3];
+				const double* P2 = &Positions[Result[Other] * 3];
+
+				double E1[3] = { P1[0] - P0[0], P1[1] - P0[1], P1[2] - P0[2] };
+				double E2[3] = { P2[0] - P0[0], P2[1] - P0[1], P2[2] - P0[2] };
+				double F1[3] = { P1[0] - Target[0], P1[1] - Target[1], P1[2] - Target[2] };
+				double F2[3] = { P2[0] - Target[0], P2[1] - Target[1], P2[2] - Target[2] };
+
+				double Before[3] = { E1[1] * E2[2] - E1[2] * E2[1], E1[2] * E2[0] - E1[0] * E2[2], E1[0] * E2[1] - E1[1] * E2[0] };
+				double After[3] = { F1[1] * F2[2] - F1[2] * F2[1], F1[2] * F2[0] - F1[0] * F2[2], F1[0] * F2[1] - F1[1] * F2[0] };
+				Flips = (Before[0] * After[0] + Before[1] * After[1] + Before[2] * After[2]) <= 0;
+			}
+
+			if (Flips)
+			{
+				continue;
+			}
+
+			CollapseRemap[From] = To;
+			if (Kinds[From] == TSEAM)
+			{
+				CollapseRemap[FromTwin] = ToTwin;
+			}
+
+			Quadrics[ToPosition].Add(Quadrics[FromPosition]);
+			Touched[FromPosition] = 1;
+			Touched[ToPosition] = 1;
+			Removed += (Kinds[From] == TBORDER) ? 1 : 2;
+			MaxError = std::max(MaxError, (double)Collapse.Cost);
+			Performed++;
+		}
+
+		if (Performed == 0)
+		{
+			break;
+		}
+
+		//move collapsed corners and drop the triangles that lost their area
+		unsigned int Kept = 0;
+		for (unsigned int Corner = 0; Corner < CornerCount; Corner += 3)
+		{
+			unsigned int A = CollapseRemap[Result[Corner]];
+			unsigned int B = CollapseRemap[Result[Corner + 1]];
+			unsigned int C = CollapseRemap[Result[Corner + 2]];
+
+			if (Remap[A] != Remap[B] && Remap[B] != Remap[C] && Remap[A] != Remap[C])
+			{
+				Result[Kept++] = A;
+				Result[Kept++] = B;
+				Result[Kept++] = C;
+			}
+		}
+		Result.resize(Kept);
+
+		BuildAdjacency();
+	}
+
+	return (float)sqrt(MaxError);
+}
+
+//a cluster of at most a few dozen triangles with its own small vertex list.
+//triangles index into this meshlet's run of vertices, which index the mesh
+template<typename Type>
+struct TMeshlet
+{
+	TMeshlet() : VertexOffset(0), VertexCount(0), TriangleOffset(0), TriangleCount(0), Radius(0), ConeCutoff(1)
+	{
+		memset(Center, 0, sizeof(Center));
+		memset(ConeApex, 0, sizeof(ConeApex));
+		memset(ConeAxis, 0, sizeof(ConeAxis));
+	}
+
+	//every triangle faces away from a camera at Position, so the whole meshlet can be skipped
+	bool IsBackFacing(const Type* Position) const
+	{
+		Type Direction[3] = { ConeApex[0] - Position[0], ConeApex[1] - Position[1], ConeApex[2] - Position[2] };
+		Type Length = sqrt(Direction[0] * Direction[0] + Direction[1] * Direction[1] + Direction[2] * Direction[2]);
+		Type Dot = Direction[0] * ConeAxis[0] + Direction[1] * ConeAxis[1] + Direction[2] * ConeAxis[2];
+		return Dot >= ConeCutoff * Length;
+	}
+
+	//first entries in the mesh's MeshletVertices and MeshletTriangles (3 per triangle)
+	unsigned int VertexOffset;
+	unsigned int VertexCount;
+	unsigned int TriangleOffset;
+	unsigned int TriangleCount;
+
+	Type Center[3];
+	Type Radius;
+
+	//normal cone, a cutoff of 1 means the normals spread too far to ever cull
+	Type ConeApex[3];
+	Type ConeAxis[3];
+	Type ConeCutoff;
+};
+
+//splits an index buffer into meshlets of at most MaxVertices vertices (255 at
+//most) and MaxTriangles triangles, in index order, so run it on a cache
+//optimized buffer to get compact clusters. each meshlet gets a bounding sphere
+//and a normal cone. MeshletVertices holds mesh vertex indices and
+//MeshletTriangles 3 local vertex indices per triangle
+template<typename VertexType, typename ScalarType>
+void BuildMeshlets(const std::vector<unsigned int>& Indices, const std::vector<VertexType>& Vertices, unsigned int PositionOffset,
+	unsigned int MaxVertices, unsigned int MaxTriangles, std::vector<TMeshlet<ScalarType>>& Meshlets,
+	std::vector<unsigned int>& MeshletVertices, std::vector<unsigned char>& MeshletTriangles)
+{
+	Meshlets.clear();
+	MeshletVertices.clear();
+	MeshletTriangles.clear();
+
+	unsigned int TriangleCount = Indices.size() / 3;
+	MaxVertices = std::min(std::max(MaxVertices, 3u), 255u);
+	MaxTriangles = std::max(MaxTriangles, 1u);
+	if (TriangleCount == 0)
+	{
+		return;
+	}
+
+	auto Position = [&](unsigned int Vertex) -> const ScalarType*
+	{
+		return (const ScalarType*)((const unsigned char*)&Vertices[Vertex] + PositionOffset);
+	};
+
+	//slot of each mesh vertex in the meshlet being filled, 0xff when it is not in it
+	std::vector<unsigned char> Slots(Vertices.size(), 0xff);
+	TMeshlet<ScalarType> Meshlet;
+
+	auto Finish = [&]()
+	{
+		const unsigned int* Local = &MeshletVertices[Meshlet.VertexOffset];
+		const unsigned char* Triangles = &MeshletTriangles[Meshlet.TriangleOffset * 3];
+
+		//sphere around the box centre, which is close enough for clusters this small
+		ScalarType Min[3], Max[3];
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Min[Component] = Max[Component] = Position(Local[0])[Component];
+		}
+
+		for (unsigned int VertexIter = 0; VertexIter < Meshlet.VertexCount; VertexIter++)
+		{
+			const ScalarType* P = Position(Local[VertexIter]);
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				Min[Component] = std::min(Min[Component], P[Component]);
+				Max[Component] = std::max(Max[Component], P[Component]);
+			}
+			Slots[Local[VertexIter]] = 0xff;
+		}
+
+		ScalarType RadiusSquared = 0;
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Meshlet.Center[Component] = (Min[Component] + Max[Component]) / 2;
+		}
+
+		for (unsigned int VertexIter = 0; VertexIter < Meshlet.VertexCount; VertexIter++)
+		{
+			const ScalarType* P = Position(Local[VertexIter]);
+			ScalarType D[3] = { P[0] - Meshlet.Center[0], P[1] - Meshlet.Center[1], P[2] - Meshlet.Center[2] };
+			RadiusSquared = std::max(RadiusSquared, D[0] * D[0] + D[1] * D[1] + D[2] * D[2]);
+		}
+		Meshlet.Radius = sqrt(RadiusSquared);
+
+		//cone axis is the mean unit normal, the cutoff comes from the widest normal
+		std::vector<ScalarType> Normals(Meshlet.TriangleCount * 3, 0);
+		ScalarType Axis[3] = { 0, 0, 0 };
+
+		for (unsigned int Triangle = 0; Triangle < Meshlet.TriangleCount; Triangle++)
+		{
+			const ScalarType* P0 = Position(Local[Triangles[Triangle * 3]]);
+			const ScalarType* P1 = Position(Local[Triangles[Triangle * 3 + 1]]);
+			const ScalarType* P2 = Position(Local[Triangles[Triangle * 3 + 2]]);
+
+			ScalarType E1[3] = { P1[0] - P0[0], P1[1] - P0[1], P1[2] - P0[2] };
+			ScalarType E2[3] = { P2[0] - P0[0], P2[1] - P0[1], P2[2] - P0[2] };
+			ScalarType* Normal = &Normals[Triangle * 3];
+			Normal[0] = E1[1] * E2[2] - E1[2] * E2[1];
+			Normal[1] = E1[2] * E2[0] - E1[0] * E2[2];
+			Normal[2] = E1[0] * E2[1] - E1[1] * E2[0];
+
+			ScalarType Length = sqrt(Normal[0] * Normal[0] + Normal[1] * Normal[1] + Normal[2] * Normal[2]);
+			ScalarType Inverse = (Length > 0) ? 1 / Length : 0;
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				Normal[Component] *= Inverse;
+				Axis[Component] += Normal[Component];
+			}
+		}
+
+		ScalarType AxisLength = sqrt(Axis[0] * Axis[0] + Axis[1] * Axis[1] + Axis[2] * Axis[2]);
+		ScalarType MinDot = 1;
+		if (AxisLength > 0)
+		{
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				Axis[Component] /= AxisLength;
+			}
+
+			for (unsigned int Triangle = 0; Triangle < Meshlet.TriangleCount; Triangle++)
+			{
+				const ScalarType* Normal = &Normals[Triangle * 3];
+				MinDot = std::min(MinDot, Normal[0] * Axis[0] + Normal[1] * Axis[1] + Normal[2] * Axis[2]);
+			}
+		}
+		else
+		{
+			MinDot = 0;
+		}
+
+		memcpy(Meshlet.ConeAxis, Axis, sizeof(Axis));
+		memcpy(Meshlet.ConeApex, Meshlet.Center, sizeof(Axis));
+		Meshlet.ConeCutoff = 1;
+
+		if (MinDot > 0)
+		{
+			//pull the apex back along the axis until it is behind every triangle's plane
+			ScalarType MaxT = 0;
+			for (unsigned int Triangle = 0; Triangle < Meshlet.TriangleCount; Triangle++)
+			{
+				const ScalarType* Normal = &Normals[Triangle * 3];
+				const ScalarType* P0 = Position(Local[Triangles[Triangle * 3]]);
+				ScalarType DC = (Meshlet.Center[0] - P0[0]) * Normal[0] + (Meshlet.Center[1] - P0[1]) * Normal[1] + (Meshlet.Center[2] - P0[2]) * Normal[2];
+				ScalarType DN = Axis[0] * Normal[0] + Axis[1] * Normal[1] + Axis[2] * Normal[2];
+				MaxT = std::max(MaxT, DC / DN);
+			}
+
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				Meshlet.ConeApex[Component] = Meshlet.Center[Component] - Axis[Component] * MaxT;
+			}
+			Meshlet.ConeCutoff = sqrt(1 - MinDot * MinDot);
+		}
+
+		Meshlets.push_back(Meshlet);
+		Meshlet = TMeshlet<ScalarType>();
+		Meshlet.VertexOffset = MeshletVertices.size();
+		Meshlet.TriangleOffset = MeshletTriangles.size() / 3;
+	};
+
+	for (unsigned int Triangle = 0; Triangle < TriangleCount; Triangle++)
+	{
+		const unsigned int* Corners = &Indices[Triangle * 3];
+
+		unsigned int NewVertices = 0;
+		for (unsigned int Corner = 0; Corner < 3; Corner++)
+		{
+			bool Repeat = (Corner > 0 && Corners[Corner] == Corners[0]) || (Corner > 1 && Corners[Corner] == Corners[1]);
+			NewVertices += (Slots[Corners[Corner]] == 0xff && !Repeat) ? 1 : 0;
+		}
+
+		if (Meshlet.VertexCount + NewVertices > MaxVertices || Meshlet.TriangleCount + 1 > MaxTriangles)
+		{
+			Finish();
+		}
+
+		for (unsigned int Corner = 0; Corner < 3; Corner++)
+		{
+			unsigned int Vertex = Corners[Corner];
+			if (Slots[Vertex] == 0xff)
+			{
+				Slots[Vertex] = (unsigned char)Meshlet.VertexCount++;
+				MeshletVertices.push_back(Vertex);
+			}
+			MeshletTriangles.push_back(Slots[Vertex]);
+		}
+		Meshlet.TriangleCount++;
+	}
+
+	Finish();
+}
+
+//axis aligned box and bounding sphere of a vertex array. the sphere is
+//centred on the box, which is loose but stable for small changes
+template<typename VertexType, typename ScalarType>
+void ComputeBounds(const std::vector<VertexType>& Vertices, unsigned int PositionOffset,
+	ScalarType* Min, ScalarType* Max, ScalarType* Center, ScalarType& Radius)
+{
+	for (unsigned int Component = 0; Component < 3; Component++)
+	{
+		Min[Component] = Max[Component] = Center[Component] = 0;
+	}
+	Radius = 0;
+
+	if (Vertices.empty())
+	{
+		return;
+	}
+
+	const ScalarType* First = (const ScalarType*)((const unsigned char*)&Vertices[0] + PositionOffset);
+	memcpy(Min, First, sizeof(ScalarType) * 3);
+	memcpy(Max, First, sizeof(ScalarType) * 3);
+
+	for (unsigned int Vertex = 1; Vertex < Vertices.size(); Vertex++)
+	{
+		const ScalarType* Position = (const ScalarType*)((const unsigned char*)&Vertices[Vertex] + PositionOffset);
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Min[Component] = std::min(Min[Component], Position[Component]);
+			Max[Component] = std::max(Max[Component], Position[Component]);
+		}
+	}
+
+	ScalarType RadiusSquared = 0;
+	for (unsigned int Component = 0; Component < 3; Component++)
+	{
+		Center[Component] = (Min[Component] + Max[Component]) / 2;
+	}
+
+	for (unsigned int Vertex = 0; Vertex < Vertices.size(); Vertex++)
+	{
+		const ScalarType* Position = (const ScalarType*)((const unsigned char*)&Vertices[Vertex] + PositionOffset);
+		ScalarType D[3] = { Position[0] - Center[0], Position[1] - Center[1], Position[2] - Center[2] };
+		RadiusSquared = std::max(RadiusSquared, D[0] * D[0] + D[1] * D[1] + D[2] * D[2]);
+	}
+	Radius = sqrt(RadiusSquared);
+}
+
+//box that holds a local box once transformed by a row major matrix with the
+//translation in the last row (Arvo)
+template<typename Type>
+void TransformBounds(const Type* Min, const Type* Max, const Type* Matrix, Type* WorldMin, Type* WorldMax)
+{
+	for (unsigned int Column = 0; Column < 3; Column++)
+	{
+		WorldMin[Column] = WorldMax[Column] = Matrix[12 + Column];
+
+		for (unsigned int Row = 0; Row < 3; Row++)
+		{
+			Type A = Min[Row] * Matrix[Row * 4 + Column];
+			Type B = Max[Row] * Matrix[Row * 4 + Column];
+			WorldMin[Column] += std::min(A, B);
+			WorldMax[Column] += std::max(A, B);
+		}
+	}
+}
+
+//the six clip planes of a view projection matrix in the row vector layout
+//above, as a x + b y + c z + d >= 0 inside with unit normals
+template<typename Type>
+struct TFrustum
+{
+	TFrustum(){}
+
+	explicit TFrustum(const Type* ViewProjection)
+	{
+		for (unsigned int Plane = 0; Plane < 6; Plane++)
+		{
+			//left, right, bottom, top, near, far
+			unsigned int Axis = Plane / 2;
+			Type Sign = (Plane % 2 == 0) ? (Type)1 : (Type)-1;
+
+			for (unsigned int Row = 0; Row < 4; Row++)
+			{
+				Planes[Plane][Row] = ViewProjection[Row * 4 + 3] + Sign * ViewProjection[Row * 4 + Axis];
+			}
+
+			Type Length = sqrt(Planes[Plane][0] * Planes[Plane][0] + Planes[Plane][1] * Planes[Plane][1] + Planes[Plane][2] * Planes[Plane][2]);
+			if (Length > 0)
+			{
+				for (unsigned int Row = 0; Row < 4; Row++)
+				{
+					Planes[Plane][Row] /= Length;
+				}
+			}
+		}
+	}
+
+	Type Planes[6][4];
+};
+
+//world boxes kept as centre and half extent arrays, padded to whole batches,
+//so Cull runs the plane tests over BatchSize boxes at a time as straight lane
+//loops the compiler turns into 4 or 8 wide vector code
+template<typename Type>
+struct TBoundsBatch
+{
+	enum
+	{
+		BatchSize = 8
+	};
+
+	TBoundsBatch() : Count(0){}
+
+	void Resize(unsigned int BoxCount)
+	{
+		Count = BoxCount;
+		unsigned int Padded = (BoxCount + BatchSize - 1) / BatchSize * BatchSize;
+
+		//padding boxes sit at the origin with a negative extent so they never pass
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Centers[Component].assign(Padded, 0);
+			Extents[Component].assign(Padded, -1);
+		}
+	}
+
+	void Set(unsigned int Box, const Type* Min, const Type* Max)
+	{
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Centers[Component][Box] = (Min[Component] + Max[Component]) / 2;
+			Extents[Component][Box] = (Max[Component] - Min[Component]) / 2;
+		}
+	}
+
+	//appends the index of every box at least partly inside Frustum
+	void Cull(const TFrustum<Type>& Frustum, std::vector<unsigned int>& Visible) const
+	{
+		unsigned int Padded = Centers[0].size();
+
+		for (unsigned int First = 0; First < Padded; First += BatchSize)
+		{
+			const Type* CX = &Centers[0][First];
+			const Type* CY = &Centers[1][First];
+			const Type* CZ = &Centers[2][First];
+			const Type* EX = &Extents[0][First];
+			const Type* EY = &Extents[1][First];
+			const Type* EZ = &Extents[2][First];
+
+			Type Inside[BatchSize];
+			for (unsigned int Lane = 0; Lane < BatchSize; Lane++)
+			{
+				Inside[Lane] = 1;
+			}
+
+			for (unsigned int Plane = 0; Plane < 6; Plane++)
+			{
+				const Type* P = Frustum.Planes[Plane];
+				Type AX = fabs(P[0]), AY = fabs(P[1]), AZ = fabs(P[2]);
+
+				//a box is outside once its nearest corner is behind any plane
+				for (unsigned int Lane = 0; Lane < BatchSize; Lane++)
+				{
+					Type Distance = P[0] * CX[Lane] + P[1] * CY[Lane] + P[2] * CZ[Lane] + P[3];
+					Type Reach = AX * EX[Lane] + AY * EY[Lane] + AZ * EZ[Lane];
+					Inside[Lane] = (Distance + Reach >= 0 && EX[Lane] >= 0) ? Inside[Lane] : 0;
+				}
+			}
+
+			for (unsigned int Lane = 0; Lane < BatchSize; Lane++)
+			{
+				if (Inside[Lane] != 0 && First + Lane < Count)
+				{
+					Visible.push_back(First + Lane);
+				}
+			}
+		}
+	}
+
+	unsigned int Count;
+	std::vector<Type> Centers[3];
+	std::vector<Type> Extents[3];
+};
+
+template<typename Type>
+struct TBVHNode
+{
+	Type Min[3];
+	Type Max[3];
+
+	//leaves hold Count triangles from First in the tree's Triangles. inner
+	//nodes have a Count of 0 and their children at First and First + 1
+	unsigned int First;
+	unsigned int Count;
+};
+
+template<typename Type>
+struct TRayHit
+{
+	TRayHit() : Distance(0), Triangle(0xffffffff), U(0), V(0){}
+
+	//distance along the ray in units of its direction's length
+	Type Distance;
+	//triangle in the source index buffer, 0xffffffff on a miss
+	unsigned int Triangle;
+	//barycentric weights of the triangle's second and third corners
+	Type U;
+	Type V;
+};
+
+//bounding volume hierarchy over an indexed triangle list. the tree keeps its
+//own copy of each triangle's corners in leaf order so queries need nothing
+//else, and everything is plain arrays so it can be written out as is.
+//queries are in the space of the positions it was built from
+template<typename Type>
+class TMeshBVH
+{
+public:
+
+	enum
+	{
+		MaxLeafSize = 4,
+		BinCount = 16,
+		StackSize = 64
+	};
+
+	//binned SAH build. every node of a level is split as its own parallel task
+	template<typename VertexType>
+	void Build(const std::vector<unsigned int>& Indices, const std::vector<VertexType>& Vertices,
+		unsigned int PositionOffset, unsigned int ThreadCount = 0)
+	{
+		Clear();
+		unsigned int TriangleCount = Indices.size() / 3;
+		if (TriangleCount == 0)
+		{
+			return;
+		}
+
+		//per triangle box and centroid, 3 scalars each
+		std::vector<Type> Boxes(TriangleCount * 6);
+		std::vector<Type> Centroids(TriangleCount * 3);
+		Triangles.resize(TriangleCount);
+
+		for (unsigned int Triangle = 0; Triangle < TriangleCount; Triangle++)
+		{
+			Triangles[Triangle] = Triangle;
+			Type* Box = &Boxes[Triangle * 6];
+
+			for (unsigned int Corner = 0; Corner < 3; Corner++)
+			{
+				const Type* P = (const Type*)((const unsigned char*)&Vertices[Indices[Triangle * 3 + Corner]] + PositionOffset);
+				for (unsigned int Component = 0; Component < 3; Component++)
+				{
+					Box[Component] = (Corner == 0) ? P[Component] : std::min(Box[Component], P[Component]);
+					Box[3 + Component] = (Corner == 0) ? P[Component] : std::max(Box[3 + Component], P[Component]);
+				}
+			}
+
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				Centroids[Triangle * 3 + Component] = (Box[Component] + Box[3 + Component]) / 2;
+			}
+		}
+
+		TBVHNode<Type> Root;
+		Root.First = 0;
+		Root.Count = TriangleCount;
+		Nodes.push_back(Root);
+
+		std::vector<unsigned int> Level(1, 0);
+		std::vector<unsigned int> Splits;
+
+		for (unsigned int Depth = 0; !Level.empty(); Depth++)
+		{
+			//each task fits its node's box and partitions its own range of Triangles.
+			//the last level a traversal stack can reach is left as leaves
+			bool Split = Depth + 2 < StackSize;
+			Splits.assign(Level.size(), 0);
+			ParallelFor(Level.size(), ThreadCount, [&](unsigned int LevelIter)
+			{
+				Splits[LevelIter] = SplitNode(Nodes[Level[LevelIter]], Boxes, Centroids, Split);
+			});
+
+			std::vector<unsigned int> NextLevel;
+			for (unsigned int LevelIter = 0; LevelIter < Level.size(); LevelIter++)
+			{
+				if (Splits[LevelIter] == 0)
+				{
+					continue;
+				}
+
+				unsigned int Parent = Level[LevelIter];
+				TBVHNode<Type> Left, Right;
+				Left.First = Nodes[Parent].First;
+				Left.Count = Splits[LevelIter];
+				Right.First = Left.First + Left.Count;
+				Right.Count = Nodes[Parent].Count - Left.Count;
+
+				Nodes[Parent].First = Nodes.size();
+				Nodes[Parent].Count = 0;
+				NextLevel.push_back(Nodes.size());
+				Nodes.push_back(Left);
+				NextLevel.push_back(Nodes.size());
+				Nodes.push_back(Right);
+			}
+			Level.swap(NextLevel);
+		}
+
+		Positions.resize(TriangleCount * 9);
+		for (unsigned int Leaf = 0; Leaf < TriangleCount; Leaf++)
+		{
+			for (unsigned int Corner = 0; Corner < 3; Corner++)
+			{
+				const Type* P = (const Type*)((const unsigned char*)&Vertices[Indices[Triangles[Leaf] * 3 + Corner]] + PositionOffset);
+				memcpy(&Positions[Leaf * 9 + Corner * 3], P, sizeof(Type) * 3);
+			}
+		}
+	}
+
+	void Clear()
+	{
+		Nodes.clear();
+		Triangles.clear();
+		Positions.clear();
+	}
+
+	//nearest hit along Origin + Direction * t for t in [0, MaxDistance]
+	bool Intersect(const Type* Origin, const Type* Direction, Type MaxDistance, TRayHit<Type>& Hit) const
+	{
+		Hit = TRayHit<Type>();
+		Hit.Distance = MaxDistance;
+		Traverse(Origin, Direction, Hit, false);
+		return Hit.Triangle != 0xffffffff;
+	}
+
+	//whether anything is hit before MaxDistance, stopping at the first hit found
+	bool Occluded(const Type* Origin, const Type* Direction, Type MaxDistance) const
+	{
+		TRayHit<Type> Hit;
+		Hit.Distance = MaxDistance;
+		Traverse(Origin, Direction, Hit, true);
+		return Hit.Triangle != 0xffffffff;
+	}
+
+	//Intersect over a stream of rays, 3 scalars per origin and direction, split across threads
+	void IntersectRays(const Type* Origins, const Type* Directions, unsigned int RayCount, Type MaxDistance,
+		TRayHit<Type>* Hits, unsigned int ThreadCount = 0) const
+	{
+		const unsigned int BlockSize = 64;
+		ParallelFor((RayCount + BlockSize - 1) / BlockSize, ThreadCount, [&](unsigned int BlockIter)
+		{
+			unsigned int Last = std::min((BlockIter + 1) * BlockSize, RayCount);
+			for (unsigned int Ray = BlockIter * BlockSize; Ray < Last; Ray++)
+			{
+				Intersect(Origins + Ray * 3, Directions + Ray * 3, MaxDistance, Hits[Ray]);
+			}
+		});
+	}
+
+	//Occluded over a stream of rays, Results gets 1 for every blocked ray
+	void OccludedRays(const Type* Origins, const Type* Directions, unsigned int RayCount, Type MaxDistance,
+		unsigned char* Results, unsigned int ThreadCount = 0) const
+	{
+		const unsigned int BlockSize = 64;
+		ParallelFor((RayCount + BlockSize - 1) / BlockSize, ThreadCount, [&](unsigned int BlockIter)
+		{
+			unsigned int Last = std::min((BlockIter + 1) * BlockSize, RayCount);
+			for (unsigned int Ray = BlockIter * BlockSize; Ray < Last; Ray++)
+			{
+				Results[Ray] = Occluded(Origins + Ray * 3, Directions + Ray * 3, MaxDistance) ? 1 : 0;
+			}
+		});
+	}
+
+	//nearest point on the surface within MaxDistance of Point. returns the
+	//triangle it lies on, 0xffffffff if there is none that close
+	unsigned int ClosestPoint(const Type* Point, Type MaxDistance, Type* Closest) const
+	{
+		unsigned int Best = 0xffffffff;
+		Type BestSquared = MaxDistance * MaxDistance;
+		if (Nodes.empty())
+		{
+			return Best;
+		}
+
+		unsigned int Stack[StackSize];
+		unsigned int StackCount = 0;
+		Stack[StackCount++] = 0;
+
+		while (StackCount > 0)
+		{
+			const TBVHNode<Type>& Node = Nodes[Stack[--StackCount]];
+			if (BoxDistanceSquared(Node, Point) > BestSquared)
+			{
+				continue;
+			}
+
+			if (Node.Count > 0)
+			{
+				for (unsigned int Leaf = Node.First; Leaf < Node.First + Node.Count; Leaf++)
+				{
+					Type Candidate[3];
+					ClosestOnTriangle(&Positions[Leaf * 9], Point, Candidate);
+					Type D[3] = { Candidate[0] - Point[0], Candidate[1] - Point[1], Candidate[2] - Point[2] };
+					Type Squared = D[0] * D[0] + D[1] * D[1] + D[2] * D[2];
+
+					if (Squared <= BestSquared)
+					{
+						BestSquared = Squared;
+						Best = Triangles[Leaf];
+						memcpy(Closest, Candidate, sizeof(Type) * 3);
+					}
+				}
+				continue;
+			}
+
+			//the nearer child goes on top of the stack
+			Type Near = BoxDistanceSquared(Nodes[Node.First], Point);
+			Type Far = BoxDistanceSquared(Nodes[Node.First + 1], Point);
+			unsigned int First = (Near <= Far) ? Node.First : Node.First + 1;
+			Stack[StackCount++] = (First == Node.First) ? Node.First + 1 : Node.First;
+			Stack[StackCount++] = First;
+		}
+
+		return Best;
+	}
+
+	//ClosestPoint over a stream of points, split across threads
+	void ClosestPoints(const Type* Points, unsigned int PointCount, Type MaxDistance,
+		Type* Closest, unsigned int* ClosestTriangles, unsigned int ThreadCount = 0) const
+	{
+		const unsigned int BlockSize = 64;
+		ParallelFor((PointCount + BlockSize - 1) / BlockSize, ThreadCount, [&](unsigned int BlockIter)
+		{
+			unsigned int Last = std::min((BlockIter + 1) * BlockSize, PointCount);
+			for (unsigned int PointIter = BlockIter * BlockSize; PointIter < Last; PointIter++)
+			{
+				ClosestTriangles[PointIter] = ClosestPoint(Points + PointIter * 3, MaxDistance, Closest + PointIter * 3);
+			}
+		});
+	}
+
+	std::vector<TBVHNode<Type>> Nodes;
+	//source triangle of each leaf slot
+	std::vector<unsigned int> Triangles;
+	//the 3 corners of each leaf slot's triangle
+	std::vector<Type> Positions;
+
+private:
+
+	//fits Node's box and returns how many of its triangles go left, 0 to keep it a leaf
+	unsigned int SplitNode(TBVHNode<Type>& Node, const std::vector<Type>& Boxes, const std::vector<Type>& Centroids, bool Split)
+	{
+		unsigned int* Range = &Triangles[Node.First];
+		Type CentroidMin[3], CentroidMax[3];
+
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Node.Min[Component] = Boxes[Range[0] * 6 + Component];
+			Node.Max[Component] = Boxes[Range[0] * 6 + 3 + Component];
+			CentroidMin[Component] = CentroidMax[Component] = Centroids[Range[0] * 3 + Component];
+		}
+
+		for (unsigned int RangeIter = 1; RangeIter < Node.Count; RangeIter++)
+		{
+			unsigned int Triangle = Range[RangeIter];
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				Node.Min[Component] = std::min(Node.Min[Component], Boxes[Triangle * 6 + Component]);
+				Node.Max[Component] = std::max(Node.Max[Component], Boxes[Triangle * 6 + 3 + Component]);
+				CentroidMin[Component] = std::min(CentroidMin[Component], Centroids[Triangle * 3 + Component]);
+				CentroidMax[Component] = std::max(CentroidMax[Component], Centroids[Triangle * 3 + Component]);
+			}
+		}
+
+		if (Node.Count <= MaxLeafSize || !Split)
+		{
+			return 0;
+		}
+
+		Type BestCost = (Type)Node.Count * HalfArea(Node.Min, Node.Max);
+		unsigned int BestAxis = 3, BestBin = 0;
+
+		for (unsigned int Axis = 0; Axis < 3; Axis++)
+		{
+			Type Extent = CentroidMax[Axis] - CentroidMin[Axis];
+			if (Extent <= 0)
+			{
+				continue;
+			}
+
+			unsigned int Counts[BinCount] = {};
+			Type BinMin[BinCount][3], BinMax[BinCount][3];
+			Type Scale = (Type)BinCount / Extent;
+
+			for (unsigned int RangeIter = 0; RangeIter < Node.Count; RangeIter++)
+			{
+				unsigned int Triangle = Range[RangeIter];
+				unsigned int Bin = std::min((unsigned int)((Centroids[Triangle * 3 + Axis] - CentroidMin[Axis]) * Scale), (unsigned int)BinCount - 1);
+
+				for (unsigned int Component = 0; Component < 3; Component++)
+				{
+					Type Low = Boxes[Triangle * 6 + Component];
+					Type High = Boxes[Triangle * 6 + 3 + Component];
+					BinMin[Bin][Component] = (Counts[Bin] == 0) ? Low : std::min(BinMin[Bin][Component], Low);
+					BinMax[Bin][Component] = (Counts[Bin] == 0) ? High : std::max(BinMax[Bin][Component], High);
+				}
+				Counts[Bin]++;
+			}
+
+			//sweep from the right to get the cost of every right hand side, then from the left
+			Type RightCosts[BinCount];
+			Type SweepMin[3], SweepMax[3];
+			unsigned int SweepCount = 0;
+
+			for (unsigned int Bin = BinCount; Bin-- > 1;)
+			{
+				GrowBox(SweepMin, SweepMax, SweepCount, BinMin[Bin], BinMax[Bin], Counts[Bin]);
+				SweepCount += Counts[Bin];
+				RightCosts[Bin] = (SweepCount > 0) ? (Type)SweepCount * HalfArea(SweepMin, SweepMax) : 0;
+			}
+
+			SweepCount = 0;
+			for (unsigned int Bin = 0; Bin + 1 < BinCount; Bin++)
+			{
+				GrowBox(SweepMin, SweepMax, SweepCount, BinMin[Bin], BinMax[Bin], Counts[Bin]);
+				SweepCount += Counts[Bin];
+				if (SweepCount == 0 || SweepCount == Node.Count)
+				{
+					continue;
+				}
+
+				//one traversal step is weighed as one triangle test
+				Type Cost = (Type)SweepCount * HalfArea(SweepMin, SweepMax) + RightCosts[Bin + 1] + HalfArea(Node.Min, Node.Max);
+				if (Cost < BestCost)
+				{
+					BestCost = Cost;
+					BestAxis = Axis;
+					BestBin = Bin;
+				}
+			}
+		}
+
+		if (BestAxis == 3)
+		{
+			//too many triangles on top of each other for a leaf, split them down the middle
+			return (Node.Count > MaxLeafSize * 4) ? Node.Count / 2 : 0;
+		}
+
+		Type Scale = (Type)BinCount / (CentroidMax[BestAxis] - CentroidMin[BestAxis]);
+		unsigned int* Middle = std::partition(Range, Range + Node.Count, [&](unsigned int Triangle)
+		{
+			return std::min((unsigned int)((Centroids[Triangle * 3 + BestAxis] - CentroidMin[BestAxis]) * Scale), (unsigned int)BinCount - 1) <= BestBin;
+		});
+
+		return Middle - Range;
+	}
+
+	static void GrowBox(Type* Min, Type* Max, unsigned int Count, const Type* OtherMin, const Type* OtherMax, unsigned int OtherCount)
+	{
+		if (OtherCount == 0)
+		{
+			return;
+		}
+
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Min[Component] = (Count == 0) ? OtherMin[Component] : std::min(Min[Component], OtherMin[Component]);
+			Max[Component] = (Count == 0) ? OtherMax[Component] : std::max(Max[Component], OtherMax[Component]);
+		}
+	}
+
+	static Type HalfArea(const Type* Min, const Type* Max)
+	{
+		Type X = Max[0] - Min[0], Y = Max[1] - Min[1], Z = Max[2] - Min[2];
+		return X * Y + Y * Z + Z * X;
+	}
+
+	static Type BoxDistanceSquared(const TBVHNode<Type>& Node, const Type* Point)
+	{
+		Type Squared = 0;
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Type Outside = std::max(std::max(Node.Min[Component] - Point[Component], Point[Component] - Node.Max[Component]), (Type)0);
+			Squared += Outside * Outside;
+		}
+		return Squared;
+	}
+
+	//slab test, returns the entry distance or a negative value on a miss
+	static Type RayBox(const TBVHNode<Type>& Node, const Type* Origin, const Type* Inverse, Type MaxDistance)
+	{
+		Type Near = 0, Far = MaxDistance;
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Type T0 = (Node.Min[Component] - Origin[Component]) * Inverse[Component];
+			Type T1 = (Node.Max[Component] - Origin[Component]) * Inverse[Component];
+			Near = std::max(Near, std::min(T0, T1));
+			Far = std::min(Far, std::max(T0, T1));
+		}
+		return (Near <= Far) ? Near : -1;
+	}
+
+	void Traverse(const Type* Origin, const Type* Direction, TRayHit<Type>& Hit, bool AnyHit) const
+	{
+		if (Nodes.empty())
+		{
+			return;
+		}
+
+		//a zero direction component gives an infinite inverse, which the slab test handles
+		Type Inverse[3];
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Inverse[Component] = (Direction[Component] != 0) ? 1 / Direction[Component] : (Type)1e30;
+		}
+
+		unsigned int Stack[StackSize];
+		unsigned int StackCount = 0;
+		if (RayBox(Nodes[0], Origin, Inverse, Hit.Distance) >= 0)
+		{
+			Stack[StackCount++] = 0;
+		}
+
+		while (StackCount > 0)
+		{
+			const TBVHNode<Type>& Node = Nodes[Stack[--StackCount]];
+
+			if (Node.Count > 0)
+			{
+				for (unsigned int Leaf = Node.First; Leaf < Node.First + Node.Count; Leaf++)
+				{
+					if (RayTriangle(&Positions[Leaf * 9], Origin, Direction, Hit))
+					{
+						Hit.Triangle = Triangles[Leaf];
+						if (AnyHit)
+						{
+							return;
+						}
+					}
+				}
+				continue;
+			}
+
+			Type Left = RayBox(Nodes[Node.First], Origin, Inverse, Hit.Distance);
+			Type Right = RayBox(Nodes[Node.First + 1], Origin, Inverse, Hit.Distance);
+
+			//push the further child first so the nearer one is visited next
+			if (Left >= 0 && Right >= 0)
+			{
+				bool LeftFirst = Left <= Right;
+				Stack[StackCount++] = LeftFirst ? Node.First + 1 : Node.First;
+				Stack[StackCount++] = LeftFirst ? Node.First : Node.First + 1;
+			}
+			else if (Left >= 0)
+			{
+				Stack[StackCount++] = Node.First;
+			}
+			else if (Right >= 0)
+			{
+				Stack[StackCount++] = Node.First + 1;
+			}
+		}
+	}
+
+	//Moller-Trumbore, two sided. only hits nearer than Hit.Distance are taken
+	static bool RayTriangle(const Type* Corners, const Type* Origin, const Type* Direction, TRayHit<Type>& Hit)
+	{
+		const Type* P0 = Corners;
+		Type E1[3] = { Corners[3] - P0[0], Corners[4] - P0[1], Corners[5] - P0[2] };
+		Type E2[3] = { Corners[6] - P0[0], Corners[7] - P0[1], Corners[8] - P0[2] };
+		Type P[3] = { Direction[1] * E2[2] - Direction[2] * E2[1], Direction[2] * E2[0] - Direction[0] * E2[2], Direction[0] * E2[1] - Direction[1] * E2[0] };
+		Type Determinant = E1[0] * P[0] + E1[1] * P[1] + E1[2] * P[2];
+
+		if (Determinant == 0)
+		{
+			return false;
+		}
+
+		Type Inverse = 1 / Determinant;
+		Type T[3] = { Origin[0] - P0[0], Origin[1] - P0[1], Origin[2] - P0[2] };
+		Type U = (T[0] * P[0] + T[1] * P[1] + T[2] * P[2]) * Inverse;
+		if (U < 0 || U > 1)
+		{
+			return false;
+		}
+
+		Type Q[3] = { T[1] * E1[2] - T[2] * E1[1], T[2] * E1[0] - T[0] * E1[2], T[0] * E1[1] - T[1] * E1[0] };
+		Type V = (Direction[0] * Q[0] + Direction[1] * Q[1] + Direction[2] * Q[2]) * Inverse;
+		if (V < 0 || U + V > 1)
+		{
+			return false;
+		}
+
+		Type Distance = (E2[0] * Q[0] + E2[1] * Q[1] + E2[2] * Q[2]) * Inverse;
+		if (Distance < 0 || Distance > Hit.Distance)
+		{
+			return false;
+		}
+
+		Hit.Distance = Distance;
+		Hit.U = U;
+		Hit.V = V;
+		return true;
+	}
+
+	//closest point on a triangle by Voronoi region (Ericson, Real-Time Collision Detection 5.1.5)
+	static void ClosestOnTriangle(const Type* Corners, const Type* Point, Type* Result)
+	{
+		const Type* A = Corners;
+		const Type* B = Corners + 3;
+		const Type* C = Corners + 6;
+
+		Type AB[3] = { B[0] - A[0], B[1] - A[1], B[2] - A[2] };
+		Type AC[3] = { C[0] - A[0], C[1] - A[1], C[2] - A[2] };
+		Type AP[3] = { Point[0] - A[0], Point[1] - A[1], Point[2] - A[2] };
+
+		auto Dot = [](const Type* X, const Type* Y) { return X[0] * Y[0] + X[1] * Y[1] + X[2] * Y[2]; };
+		auto Set = [Result](const Type* Origin, const Type* Axis1, Type S, const Type* Axis2, Type T)
+		{
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				Result[Component] = Origin[Component] + Axis1[Component] * S + Axis2[Component] * T;
+			}
+		};
+
+		Type D1 = Dot(AB, AP), D2 = Dot(AC, AP);
+		if (D1 <= 0 && D2 <= 0)
+		{
+			Set(A, AB, 0, AC, 0);
+			return;
+		}
+
+		Type BP[3] = { Point[0] - B[0], Point[1] - B[1], Point[2] - B[2] };
+		Type D3 = Dot(AB, BP), D4 = Dot(AC, BP);
+		if (D3 >= 0 && D4 <= D3)
+		{
+			Set(B, AB, 0, AC, 0);
+			return;
+		}
+
+		Type VC = D1 * D4 - D3 * D2;
+		if (VC <= 0 && D1 >= 0 && D3 <= 0)
+		{
+			Set(A, AB, D1 / (D1 - D3), AC, 0);
+			return;
+		}
+
+		Type CP[3] = { Point[0] - C[0], Point[1] - C[1], Point[2] - C[2] };
+		Type D5 = Dot(AB, CP), D6 = Dot(AC, CP);
+		if (D6 >= 0 && D5 <= D6)
+		{
+			Set(C, AB, 0, AC, 0);
+			return;
+		}
+
+		Type VB = D5 * D2 - D1 * D6;
+		if (VB <= 0 && D2 >= 0 && D6 <= 0)
+		{
+			Set(A, AB, 0, AC, D2 / (D2 - D6));
+			return;
+		}
+
+		Type VA = D3 * D6 - D5 * D4;
+		if (VA <= 0 && (D4 - D3) >= 0 && (D5 - D6) >= 0)
+		{
+			Type W = (D4 - D3) / ((D4 - D3) + (D5 - D6));
+			Type BC[3] = { C[0] - B[0], C[1] - B[1], C[2] - B[2] };
+			Set(B, BC, W, AC, 0);
+			return;
+		}
+
+		Type Denominator = 1 / (VA + VB + VC);
+		Set(A, AB, VB * Denominator, AC, VC * Denominator);
+	}
+};
+
+//bounding volume hierarchy over a changing set of item boxes, one item per
+//leaf. moving items only refits the boxes above them, and the tree is rebuilt
+//once its SAH cost has grown past RebuildThreshold times what it was built at
+template<typename Type>
+class TBoundsTree
+{
+public:
+
+	enum
+	{
+		Missing = 0xffffffff
+	};
+
+	struct TTreeNode
+	{
+		Type Min[3];
+		Type Max[3];
+		unsigned int Parent;
+		//children, or Left is the item and Right is Missing for a leaf
+		unsigned int Left;
+		unsigned int Right;
+	};
+
+	TBoundsTree() : RebuildThreshold((Type)1.5), BuiltCost(0), Cost(0){}
+
+	//Boxes holds min x, y, z then max x, y, z for each of Count items
+	void Build(const Type* Boxes, unsigned int Count)
+	{
+		ItemBoxes.assign(Boxes, Boxes + Count * 6);
+		Rebuild();
+	}
+
+	//rebuilds from the current item boxes with median splits on the widest centroid axis
+	void Rebuild()
+	{
+		unsigned int Count = ItemBoxes.size() / 6;
+		Nodes.clear();
+		Leaves.assign(Count, Missing);
+		Dirty.clear();
+
+		if (Count == 0)
+		{
+			BuiltCost = Cost = 0;
+			return;
+		}
+
+		std::vector<unsigned int> Items(Count);
+		for (unsigned int Item = 0; Item < Count; Item++)
+		{
+			Items[Item] = Item;
+		}
+
+		Nodes.reserve(Count * 2 - 1);
+		BuildRange(Items.data(), Count, Missing);
+
+		//children always come after their parent, so a backwards pass fits every box
+		for (unsigned int Node = Nodes.size(); Node-- > 0;)
+		{
+			FitNode(Node);
+		}
+
+		Cost = MeasureCost();
+		BuiltCost = (HalfArea(Nodes[0]) > 0) ? Cost / HalfArea(Nodes[0]) : 0;
+	}
+
+	//moves one item's box. the tree is brought up to date by Refit
+	void Update(unsigned int Item, const Type* Min, const Type* Max)
+	{
+		memcpy(&ItemBoxes[Item * 6], Min, sizeof(Type) * 3);
+		memcpy(&ItemBoxes[Item * 6 + 3], Max, sizeof(Type) * 3);
+		Dirty.push_back(Item);
+	}
+
+	//refits the boxes above every updated item, stopping where a box stops
+	//changing, then rebuilds if the tree has got too loose. returns true on a rebuild
+	bool Refit()
+	{
+		for (unsigned int DirtyIter = 0; DirtyIter < Dirty.size(); DirtyIter++)
+		{
+			unsigned int Node = Leaves[Dirty[DirtyIter]];
+			while (Node != Missing && FitNode(Node))
+			{
+				Node = Nodes[Node].Parent;
+			}
+		}
+		Dirty.clear();
+
+		Type RootArea = Nodes.empty() ? 0 : HalfArea(Nodes[0]);
+		if (RootArea > 0 && BuiltCost > 0 && Cost / RootArea > BuiltCost * RebuildThreshold)
+		{
+			Rebuild();
+			return true;
+		}
+		return false;
+	}
+
+	//items whose boxes overlap the box Min to Max
+	void QueryBox(const Type* Min, const Type* Max, std::vector<unsigned int>& Items) const
+	{
+		Query(Items, [&](const TTreeNode& Node)
+		{
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				if (Node.Min[Component] > Max[Component] || Node.Max[Component] < Min[Component])
+				{
+					return false;
+				}
+			}
+			return true;
+		});
+	}
+
+	//items whose boxes Origin + Direction * t passes through for t in [0, MaxDistance]
+	void QueryRay(const Type* Origin, const Type* Direction, Type MaxDistance, std::vector<unsigned int>& Items) const
+	{
+		Type Inverse[3];
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Inverse[Component] = (Direction[Component] != 0) ? 1 / Direction[Component] : (Type)1e30;
+		}
+
+		Query(Items, [&](const TTreeNode& Node)
+		{
+			Type Near = 0, Far = MaxDistance;
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				Type T0 = (Node.Min[Component] - Origin[Component]) * Inverse[Component];
+				Type T1 = (Node.Max[Component] - Origin[Component]) * Inverse[Component];
+				Near = std::max(Near, std::min(T0, T1));
+				Far = std::min(Far, std::max(T0, T1));
+			}
+			return Near <= Far;
+		});
+	}
+
+	//items whose boxes reach into Frustum
+	void QueryFrustum(const TFrustum<Type>& Frustum, std::vector<unsigned int>& Items) const
+	{
+		Query(Items, [&](const TTreeNode& Node)
+		{
+			for (unsigned int Plane = 0; Plane < 6; Plane++)
+			{
+				const Type* P = Frustum.Planes[Plane];
+				Type Distance = P[3];
+				Type Reach = 0;
+				for (unsigned int Component = 0; Component < 3; Component++)
+				{
+					Distance += P[Component] * (Node.Min[Component] + Node.Max[Component]) / 2;
+					Reach += fabs(P[Component]) * (Node.Max[Component] - Node.Min[Component]) / 2;
+				}
+
+				if (Distance + Reach < 0)
+				{
+					return false;
+				}
+			}
+			return true;
+		});
+	}
+
+	void Clear()
+	{
+		Nodes.clear();
+		Leaves.clear();
+		ItemBoxes.clear();
+		Dirty.clear();
+		BuiltCost = Cost = 0;
+	}
+
+	std::vector<TTreeNode> Nodes;
+	//leaf node of each item
+	std::vector<unsigned int> Leaves;
+
+	//how much looser than at build time the tree may get before Refit rebuilds it
+	Type RebuildThreshold;
+
+private:
+
+	unsigned int BuildRange(unsigned int* Items, unsigned int Count, unsigned int Parent)
+	{
+		unsigned int Node = Nodes.size();
+		Nodes.push_back(TTreeNode());
+		Nodes[Node].Parent = Parent;
+
+		if (Count == 1)
+		{
+			Nodes[Node].Left = Items[0];
+			Nodes[Node].Right = Missing;
+			Leaves[Items[0]] = Node;
+			return Node;
+		}
+
+		Type Min[3], Max[3];
+		for (unsigned int ItemIter = 0; ItemIter < Count; ItemIter++)
+		{
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				Type Centre = Centroid(Items[ItemIter], Component);
+				Min[Component] = (ItemIter == 0) ? Centre : std::min(Min[Component], Centre);
+				Max[Component] = (ItemIter == 0) ? Centre : std::max(Max[Component], Centre);
+			}
+		}
+
+		unsigned int Axis = 0;
+		for (unsigned int Component = 1; Component < 3; Component++)
+		{
+			Axis = (Max[Component] - Min[Component] > Max[Axis] - Min[Axis]) ? Component : Axis;
+		}
+
+		unsigned int Half = Count / 2;
+		std::nth_element(Items, Items + Half, Items + Count, [&](unsigned int A, unsigned int B)
+		{
+			return Centroid(A, Axis) < Centroid(B, Axis);
+		});
+
+		unsigned int Left = BuildRange(Items, Half, Node);
+		unsigned int Right = BuildRange(Items + Half, Count - Half, Node);
+		Nodes[Node].Left = Left;
+		Nodes[Node].Right = Right;
+		return Node;
+	}
+
+	Type Centroid(unsigned int Item, unsigned int Component) const
+	{
+		return ItemBoxes[Item * 6 + Component] + ItemBoxes[Item * 6 + 3 + Component];
+	}
+
+	//refits one node from its item or children, returns false if nothing moved
+	bool FitNode(unsigned int Index)
+	{
+		TTreeNode& Node = Nodes[Index];
+		Type Min[3], Max[3];
+
+		if (Node.Right == Missing)
+		{
+			memcpy(Min, &ItemBoxes[Node.Left * 6], sizeof(Type) * 3);
+			memcpy(Max, &ItemBoxes[Node.Left * 6 + 3], sizeof(Type) * 3);
+		}
+		else
+		{
+			const TTreeNode& Left = Nodes[Node.Left];
+			const TTreeNode& Right = Nodes[Node.Right];
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				Min[Component] = std::min(Left.Min[Component], Right.Min[Component]);
+				Max[Component] = std::max(Left.Max[Component], Right.Max[Component]);
+			}
+		}
+
+		if (memcmp(Min, Node.Min, sizeof(Min)) == 0 && memcmp(Max, Node.Max, sizeof(Max)) == 0)
+		{
+			return false;
+		}
+
+		//the running cost only counts inner nodes, as in MeasureCost
+		if (Node.Right != Missing)
+		{
+			Cost -= HalfArea(Node);
+		}
+		memcpy(Node.Min, Min, sizeof(Min));
+		memcpy(Node.Max, Max, sizeof(Max));
+		if (Node.Right != Missing)
+		{
+			Cost += HalfArea(Node);
+		}
+		return true;
+	}
+
+	//summed inner node area, over the root's area this is the SAH traversal cost of the tree
+	Type MeasureCost() const
+	{
+		Type Sum = 0;
+		for (unsigned int Node = 0; Node < Nodes.size(); Node++)
+		{
+			Sum += (Nodes[Node].Right != Missing) ? HalfArea(Nodes[Node]) : 0;
+		}
+		return Sum;
+	}
+
+	static Type HalfArea(const TTreeNode& Node)
+	{
+		Type X = Node.Max[0] - Node.Min[0], Y = Node.Max[1] - Node.Min[1], Z = Node.Max[2] - Node.Min[2];
+		return X * Y + Y * Z + Z * X;
+	}
+
+	template<typename TestType>
+	void Query(std::vector<unsigned int>& Items, const TestType& Test) const
+	{
+		if (Nodes.empty())
+		{
+			return;
+		}
+
+		std::vector<unsigned int> Stack(1, 0);
+		while (!Stack.empty())
+		{
+			const TTreeNode& Node = Nodes[Stack.back()];
+			Stack.pop_back();
+
+			if (!Test(Node))
+			{
+				continue;
+			}
+
+			if (Node.Right == Missing)
+			{
+				Items.push_back(Node.Left);
+			}
+			else
+			{
+				Stack.push_back(Node.Right);
+				Stack.push_back(Node.Left);
+			}
+		}
+	}
+
+	std::vector<Type> ItemBoxes;
+	std::vector<unsigned int> Dirty;
+	//traversal cost right after the last rebuild
+	Type BuiltCost;
+	//summed inner node area, kept up to date by FitNode
+	Type Cost;
+};
+
+//scalar codecs for vertex quantization. values are clamped to the format's
+//range and rounded to nearest
+inline short EncodeSNorm16(float Value)
+{
+	Value = std::min(std::max(Value, -1.0f), 1.0f) * 32767.0f;
+	return (short)(Value + (Value >= 0 ? 0.5f : -0.5f));
+}
+
+inline float DecodeSNorm16(short Value)
+{
+	return std::max((float)Value / 32767.0f, -1.0f);
+}
+
+inline unsigned short EncodeUNorm16(float Value)
+{
+	return (unsigned short)(std::min(std::max(Value, 0.0f), 1.0f) * 65535.0f + 0.5f);
+}
+
+inline float DecodeUNorm16(unsigned short Value)
+{
+	return (float)Value / 65535.0f;
+}
+
+inline unsigned char EncodeUNorm8(float Value)
+{
+	return (unsigned char)(std::min(std::max(Value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+inline float DecodeUNorm8(unsigned char Value)
+{
+	return (float)Value / 255.0f;
+}
+
+//IEEE half precision with round to nearest even. out of range values become infinity
+inline unsigned short FloatToHalf(float Value)
+{
+	unsigned int Bits;
+	memcpy(&Bits, &Value, sizeof(Bits));
+
+	unsigned int Sign = (Bits >> 16) & 0x8000;
+	unsigned int FloatExponent = (Bits >> 23) & 0xff;
+	unsigned int Mantissa = Bits & 0x7fffff;
+	int Exponent = (int)FloatExponent - 127 + 15;
+
+	if (FloatExponent == 0xff)
+	{
+		return (unsigned short)(Sign | 0x7c00 | (Mantissa ? 0x200 : 0));
+	}
+
+	if (Exponent >= 31)
+	{
+		return (unsigned short)(Sign | 0x7c00);
+	}
+
+	unsigned int Shift = 13;
+	unsigned int Half = Sign | ((unsigned int)std::max(Exponent, 0) << 10);
+
+	if (Exponent <= 0)
+	{
+		//subnormal, the implicit bit becomes part of the mantissa
+		if (Exponent < -10)
+		{
+			return (unsigned short)Sign;
+		}
+		Mantissa |= 0x800000;
+		Shift = 14 - Exponent;
+	}
+
+	Half |= Mantissa >> Shift;
+	unsigned int Remainder = Mantissa & ((1u << Shift) - 1);
+	unsigned int Halfway = 1u << (Shift - 1);
+
+	//a carry out of the mantissa correctly moves on to the next exponent
+	if (Remainder > Halfway || (Remainder == Halfway && (Half & 1)))
+	{
+		Half++;
+	}
+	return (unsigned short)Half;
+}
+
+inline float HalfToFloat(unsigned short Half)
+{
+	unsigned int Sign = (unsigned int)(Half & 0x8000) << 16;
+	unsigned int Exponent = (Half >> 10) & 0x1f;
+	unsigned int Mantissa = Half & 0x3ff;
+	unsigned int Bits = Sign;
+
+	if (Exponent == 31)
+	{
+		Bits |= 0x7f800000 | (Mantissa << 13);
+	}
+	else if (Exponent != 0)
+	{
+		Bits |= ((Exponent + 127 - 15) << 23) | (Mantissa << 13);
+	}
+	else if (Mantissa != 0)
+	{
+		//subnormal half, normalised for the float exponent
+		Exponent = 127 - 15 + 1;
+		while ((Mantissa & 0x400) == 0)
+		{
+			Mantissa <<= 1;
+			Exponent--;
+		}
+		Bits |= (Exponent << 23) | ((Mantissa & 0x3ff) << 13);
+	}
+
+	float Value;
+	memcpy(&Value, &Bits, sizeof(Value));
+	return Value;
+}
+
+//unit vector to two snorm16 on the octahedron (Cigolle et al.)
+template<typename Type>
+void EncodeOctahedral(const Type* Vector, short* Encoded)
+{
+	Type Sum = fabs(Vector[0]) + fabs(Vector[1]) + fabs(Vector[2]);
+	Type X = (Sum > 0) ? Vector[0] / Sum : 0;
+	Type Y = (Sum > 0) ? Vector[1] / Sum : 0;
+
+	//the lower half folds out over the diagonals
+	if (Vector[2] < 0)
+	{
+		Type FoldX = (1 - fabs(Y)) * (X >= 0 ? 1 : -1);
+		Type FoldY = (1 - fabs(X)) * (Y >= 0 ? 1 : -1);
+		X = FoldX;
+		Y = FoldY;
+	}
+
+	Encoded[0] = EncodeSNorm16((float)X);
+	Encoded[1] = EncodeSNorm16((float)Y);
+}
+
+template<typename Type>
+void DecodeOctahedral(const short* Encoded, Type* Vector)
+{
+	Type X = (Type)DecodeSNorm16(Encoded[0]);
+	Type Y = (Type)DecodeSNorm16(Encoded[1]);
+	Type Z = 1 - fabs(X) - fabs(Y);
+	Type Fold = std::max(-Z, (Type)0);
+
+	X += (X >= 0) ? -Fold : Fold;
+	Y += (Y >= 0) ? -Fold : Fold;
+
+	Type Length = sqrt(X * X + Y * Y + Z * Z);
+	Vector[0] = X / Length;
+	Vector[1] = Y / Length;
+	Vector[2] = Z / Length;
+}
+
+//open addressing vertex welder. only the first KeyComponents scalars of a
+//vertex take part in the key so trailing bookkeeping such as the FBX control
+//point index is ignored. with an Epsilon above 0 every component is snapped
+//to a grid of that size before it is hashed and compared. TagOffset is the
+//byte offset of an int that must also match exactly, or -1 for none, so
+//skinned meshes never merge vertices from different control points.
+template<typename VertexType, typename ScalarType>
+class TVertexWelder
+{
+public:
+
+	TVertexWelder(unsigned int KeyComponents = sizeof(VertexType) / sizeof(ScalarType), ScalarType Epsilon = 0, int TagOffset = -1) :
+		KeyComponents(KeyComponents), Epsilon(Epsilon), TagOffset(TagOffset), Count(0)
+	{
+		if (this->KeyComponents * sizeof(ScalarType) > sizeof(VertexType))
+		{
+			this->KeyComponents = sizeof(VertexType) / sizeof(ScalarType);
+		}
+		Rehash(16);
+	}
+
+	//sizes the table so VertexCount unique vertices fit without growing
+	void Reserve(unsigned int VertexCount)
+	{
+		unsigned int Capacity = 16;
+		while (Capacity < VertexCount * 2)
+		{
+			Capacity <<= 1;
+		}
+
+		if (Capacity > Slots.size())
+		{
+			Rehash(Capacity);
+		}
+	}
+
+	unsigned int AddVertGetIndex(std::vector<VertexType>& Vertices, const VertexType& Vertex)
+	{
+		if ((Count + 1) * 2 > Slots.size())
+		{
+			Rehash(Slots.size() * 2);
+		}
+
+		unsigned int Hash = HashVertex(Vertex);
+		unsigned int Mask = Slots.size() - 1;
+
+		for (unsigned int Slot = Hash & Mask;; Slot = (Slot + 1) & Mask)
+		{
+			unsigned int Index = Slots[Slot];
+
+			if (Index == EmptySlot)
+			{
+				Slots[Slot] = Vertices.size();
+				Hashes[Slot] = Hash;
+				Vertices.push_back(Vertex);
+				Count++;
+				return Slots[Slot];
+			}
+
+			if (Hashes[Slot] == Hash && Equal(Vertices[Index], Vertex))
+			{
+				return Index;
+			}
+		}
+	}
+
+	void Clear()
+	{
+		Count = 0;
+		Slots.clear();
+		Hashes.clear();
+		Rehash(16);
+	}
+
+private:
+
+	enum
+	{
+		EmptySlot = 0xffffffff
+	};
+
+	long long Quantize(ScalarType Value) const
+	{
+		return (long long)floor(Value / Epsilon + (ScalarType)0.5);
+	}
+
+	unsigned int HashVertex(const VertexType& Vertex) const
+	{
+		const ScalarType* Components = (const ScalarType*)&Vertex;
+		unsigned long long Hash = 0;
+
+		for (unsigned int Iter = 0; Iter < KeyComponents; Iter++)
+		{
+			unsigned long long Bits = 0;
+			if (Epsilon > 0)
+			{
+				Bits = (unsigned long long)Quantize(Components[Iter]);
+			}
+			else
+			{
+				//adding 0 folds -0 onto +0 so they land in the same bucket
+				ScalarType Value = Components[Iter] + (ScalarType)0;
+				memcpy(&Bits, &Value, sizeof(ScalarType));
+			}
+			Hash = MixHash(Hash, Bits);
+		}
+
+		if (TagOffset >= 0)
+		{
+			Hash = MixHash(Hash, (unsigned long long)GetTag(Vertex));
+		}
+		return (unsigned int)(Hash ^ (Hash >> 32));
+	}
+
+	int GetTag(const VertexType& Vertex) const
+	{
+		int Tag;
+		memcpy(&Tag, (const unsigned char*)&Vertex + TagOffset, sizeof(int));
+		return Tag;
+	}
+
+	bool Equal(const VertexType& A, const VertexType& B) const
+	{
+		const ScalarType* AComponents = (const ScalarType*)&A;
+		const ScalarType* BComponents = (const ScalarType*)&B;
+
+		if (TagOffset >= 0 && GetTag(A) != GetTag(B))
+		{
+			return false;
+		}
+
+		for (unsigned int Iter = 0; Iter < KeyComponents; Iter++)
+		{
+			if (Epsilon > 0)
+			{
+				if (Quantize(AComponents[Iter]) != Quantize(BComponents[Iter]))
+				{
+					return false;
+				}
+			}
+			else if (AComponents[Iter] != BComponents[Iter])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void Rehash(unsigned int Capacity)
+	{
+		std::vector<unsigned int> OldSlots;
+		std::vector<unsigned int> OldHashes;
+		OldSlots.swap(Slots);
+		OldHashes.swap(Hashes);
+
+		Slots.assign(Capacity, (unsigned int)EmptySlot);
+		Hashes.assign(Capacity, 0);
+
+		unsigned int Mask = Capacity - 1;
+		for (unsigned int Iter = 0; Iter < OldSlots.size(); Iter++)
+		{
+			if (OldSlots[Iter] == EmptySlot)
+			{
+				continue;
+			}
+
+			unsigned int Slot = OldHashes[Iter] & Mask;
+			while (Slots[Slot] != EmptySlot)
+			{
+				Slot = (Slot + 1) & Mask;
+			}
+			Slots[Slot] = OldSlots[Iter];
+			Hashes[Slot] = OldHashes[Iter];
+		}
+	}
+
+	unsigned int KeyComponents;
+	ScalarType Epsilon;
+	int TagOffset;
+	unsigned int Count;
+
+	std::vector<unsigned int> Slots;
+	std::vector<unsigned int> Hashes;
+};
+
+#endif
@@ -7,6 +7,7 @@
 #include <fbxsdk.h>
 #include <algorithm>
 #include <set>
+#include "TinyHelpers.h"
 #define PI 3.14159265359f
 #define TAU 6.28318530717958657692f
 #define HALFPI 1.57079632679489661923f;
@@ -37,7 +38,8 @@ struct TVertex
 		TBiNormalOffset = TTangentOffset + sizeof(Type) * 4,
 		TIndicesOffset = TBiNormalOffset + sizeof(Type) * 4,
 		TWeightsOffset = TIndicesOffset + sizeof(Type) * 4,
-		TUVOffset = TWeightsOffset + sizeof(Type) * 4
+		TUVOffset = TWeightsOffset + sizeof(Type) * 4,
+		TControlPointOffset = TUVOffset + sizeof(Type) * 4
 	};
 
 	Type Position[4]; 
@@ -54,6 +56,533 @@ struct TVertex
 	int FBXControlPointIndex;
 };
 
+//describes a tightly packed interleaved vertex holding only some of TVertex's
+//attributes. by default every attribute keeps its scalar type but drops its
+//unused lanes, so positions and normals take 3 scalars and uvs 2. SetFormat
+//swaps an attribute for a quantized encoding instead
+template<typename Type>
+struct TVertexLayout
+{
+	enum TAttributes
+	{
+		TPosition = 1 << 0,
+		TColor = 1 << 1,
+		TNormal = 1 << 2,
+		TTangent = 1 << 3,
+		TBiNormal = 1 << 4,
+		TIndices = 1 << 5,
+		TWeights = 1 << 6,
+		TUV = 1 << 7,
+		TUV2 = 1 << 8,
+		TAttributeCount = 9,
+		TAllAttributes = (1 << 9) - 1,
+		TMissing = 0xffffffff
+	};
+
+	enum TFormats
+	{
+		//Type scalars, lossless
+		TFloat = 0,
+		//4 snorm16 relative to PositionCenter and PositionExtent, w is always 1
+		TSNorm16,
+		//2 snorm16 on the octahedron. tangents keep their handedness in the lowest bit of y
+		TOctahedral16,
+		//half floats
+		THalf,
+		//unorm16 relative to UVMin and UVRange
+		TUNorm16,
+		//4 unorm8
+		TUNorm8
+	};
+
+	TVertexLayout(unsigned int Requested = TAllAttributes)
+	{
+		Attributes = Requested & TAllAttributes;
+		memset(Constants, 0, sizeof(Constants));
+		memset(Formats, 0, sizeof(Formats));
+
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			PositionCenter[Component] = 0;
+			PositionExtent[Component] = 1;
+		}
+		for (unsigned int Set = 0; Set < 2; Set++)
+		{
+			UVMin[Set][0] = UVMin[Set][1] = 0;
+			UVRange[Set][0] = UVRange[Set][1] = 1;
+		}
+		Arrange();
+	}
+
+	//Requested minus every attribute that holds the same value on all of
+	//Vertices, such as all white colours or zero skin weights. positions are
+	//always kept, and the dropped values are kept in Constants
+	static TVertexLayout Prune(const std::vector<TVertex<Type>>& Vertices, unsigned int Requested = TAllAttributes)
+	{
+		unsigned int Constant = 0;
+
+		if (!Vertices.empty())
+		{
+			const unsigned char* First = (const unsigned char*)&Vertices[0];
+			Constant = TAllAttributes & ~TPosition;
+
+			for (unsigned int Vertex = 1; Vertex < Vertices.size() && Constant != 0; Vertex++)
+			{
+				const unsigned char* Current = (const unsigned char*)&Vertices[Vertex];
+				for (unsigned int Attribute = 0; Attribute < TAttributeCount; Attribute++)
+				{
+					unsigned int Offset = SourceOffset(Attribute);
+					if ((Constant & (1 << Attribute)) && memcmp(First + Offset, Current + Offset, Components(Attribute) * sizeof(Type)) != 0)
+					{
+						Constant &= ~(1 << Attribute);
+					}
+				}
+			}
+		}
+
+		TVertexLayout Layout(Requested & ~Constant);
+		for (unsigned int Attribute = 0; Attribute < TAttributeCount; Attribute++)
+		{
+			if ((Requested & Constant) & (1 << Attribute))
+			{
+				memcpy(Layout.Constants[Attribute], (const unsigned char*)&Vertices[0] + SourceOffset(Attribute), Components(Attribute) * sizeof(Type));
+			}
+		}
+		Layout.Fit(Vertices);
+		return Layout;
+	}
+
+	//byte offset of an attribute inside TVertex
+	static unsigned int SourceOffset(unsigned int Attribute)
+	{
+		const unsigned int Offsets[TAttributeCount] =
+		{
+			TVertex<Type>::TPositionOffset, TVertex<Type>::TColorOffset, TVertex<Type>::TNormalOffset,
+			TVertex<Type>::TTangentOffset, TVertex<Type>::TBiNormalOffset, TVertex<Type>::TIndicesOffset,
+			TVertex<Type>::TWeightsOffset, TVertex<Type>::TUVOffset, TVertex<Type>::TUVOffset + sizeof(Type) * 2
+		};
+		return Offsets[Attribute];
+	}
+
+	//scalars an attribute takes once packed. tangents keep w for their handedness
+	static unsigned int Components(unsigned int Attribute)
+	{
+		const unsigned int Counts[TAttributeCount] = { 3, 4, 3, 4, 3, 4, 4, 2, 2 };
+		return Counts[Attribute];
+	}
+
+	//whether an attribute can be stored as Format. skin indices stay as Type
+	static bool Supports(unsigned int Attribute, unsigned int Format)
+	{
+		const unsigned int Supported[TAttributeCount] =
+		{
+			(1 << TFloat) | (1 << TSNorm16),
+			(1 << TFloat) | (1 << THalf) | (1 << TUNorm8),
+			(1 << TFloat) | (1 << TOctahedral16),
+			(1 << TFloat) | (1 << TOctahedral16),
+			(1 << TFloat) | (1 << TOctahedral16),
+			(1 << TFloat),
+			(1 << TFloat) | (1 << TUNorm8),
+			(1 << TFloat) | (1 << THalf) | (1 << TUNorm16),
+			(1 << TFloat) | (1 << THalf) | (1 << TUNorm16)
+		};
+		return Attribute < TAttributeCount && Format <= TUNorm8 && (Supported[Attribute] & (1 << Format)) != 0;
+	}
+
+	//bytes an attribute takes in a packed vertex
+	unsigned int Size(unsigned int Attribute) const
+	{
+		switch (Formats[Attribute])
+		{
+			case TSNorm16: return 8;
+			case TOctahedral16: return 4;
+			case THalf: return Components(Attribute) * 2;
+			case TUNorm16: return Components(Attribute) * 2;
+			case TUNorm8: return 4;
+			default: return Components(Attribute) * sizeof(Type);
+		}
+	}
+
+	//stores the Attribute flag as Format and moves the offsets along.
+	//returns false when the attribute has no such encoding
+	bool SetFormat(unsigned int Attribute, unsigned int Format)
+	{
+		for (unsigned int AttributeIter = 0; AttributeIter < TAttributeCount; AttributeIter++)
+		{
+			if (Attribute == (1u << AttributeIter))
+			{
+				if (!Supports(AttributeIter, Format))
+				{
+					return false;
+				}
+				Formats[AttributeIter] = Format;
+				Arrange();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//the smallest encoding of every attribute, 32 bytes for an unskinned vertex instead of 84
+	void Compress()
+	{
+		const unsigned int Compact[TAttributeCount] = { TSNorm16, TUNorm8, TOctahedral16, TOctahedral16, TOctahedral16, TFloat, TUNorm8, TUNorm16, TUNorm16 };
+		memcpy(Formats, Compact, sizeof(Formats));
+		Arrange();
+	}
+
+	//sets the position and uv ranges the quantized formats are relative to
+	void Fit(const std::vector<TVertex<Type>>& Vertices)
+	{
+		if (Vertices.empty())
+		{
+			return;
+		}
+
+		Type Min[3], Max[3], Center[3], Radius;
+		ComputeBounds(Vertices, TVertex<Type>::TPositionOffset, Min, Max, Center, Radius);
+
+		Type MinUV[4], MaxUV[4];
+		for (unsigned int Component = 0; Component < 4; Component++)
+		{
+			MinUV[Component] = MaxUV[Component] = Vertices[0].UV[Component];
+		}
+		for (unsigned int Vertex = 1; Vertex < Vertices.size(); Vertex++)
+		{
+			//UV2 follows UV in memory
+			const Type* UV = Vertices[Vertex].UV;
+			for (unsigned int Component = 0; Component < 4; Component++)
+			{
+				MinUV[Component] = std::min(MinUV[Component], UV[Component]);
+				MaxUV[Component] = std::max(MaxUV[Component], UV[Component]);
+			}
+		}
+
+		//a flat axis still needs a usable scale
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			PositionCenter[Component] = (Min[Component] + Max[Component]) * (Type)0.5;
+			PositionExtent[Component] = (Max[Component] > Min[Component]) ? (Max[Component] - Min[Component]) * (Type)0.5 : 1;
+		}
+		for (unsigned int Component = 0; Component < 4; Component++)
+		{
+			UVMin[Component / 2][Component % 2] = MinUV[Component];
+			UVRange[Component / 2][Component % 2] = (MaxUV[Component] > MinUV[Component]) ? MaxUV[Component] - MinUV[Component] : 1;
+		}
+	}
+
+	//interleaves Vertices into Output, Stride bytes each. one attribute is
+	//encoded at a time so each inner loop runs a single codec down the array.
+	//Errors, when given, receives the largest error of each attribute: the
+	//angle in radians for octahedral ones and the largest component difference
+	//for the rest
+	void Pack(const std::vector<TVertex<Type>>& Vertices, std::vector<unsigned char>& Output, Type* Errors = nullptr) const
+	{
+		Output.resize(Vertices.size() * Stride);
+		unsigned int Count = (unsigned int)Vertices.size();
+
+		for (unsigned int Attribute = 0; Attribute < TAttributeCount; Attribute++)
+		{
+			if (Offsets[Attribute] == TMissing)
+			{
+				continue;
+			}
+
+			const unsigned char* Source = (const unsigned char*)Vertices.data() + SourceOffset(Attribute);
+			unsigned char* Destination = Output.data() + Offsets[Attribute];
+			unsigned int Lanes = Components(Attribute);
+			unsigned int Set = (Attribute == 8) ? 1 : 0;
+
+			switch (Formats[Attribute])
+			{
+				case TSNorm16:
+				{
+					Type Scale[3] = { 1 / PositionExtent[0], 1 / PositionExtent[1], 1 / PositionExtent[2] };
+					for (unsigned int Vertex = 0; Vertex < Count; Vertex++)
+					{
+						const Type* Value = (const Type*)(Source + Vertex * sizeof(TVertex<Type>));
+						short Encoded[4];
+						for (unsigned int Component = 0; Component < 3; Component++)
+						{
+							Encoded[Component] = EncodeSNorm16((float)((Value[Component] - PositionCenter[Component]) * Scale[Component]));
+						}
+						Encoded[3] = 32767;
+						memcpy(Destination + Vertex * Stride, Encoded, sizeof(Encoded));
+					}
+					break;
+				}
+
+				case TOctahedral16:
+				{
+					bool Handed = (Attribute == 3);
+					for (unsigned int Vertex = 0; Vertex < Count; Vertex++)
+					{
+						const Type* Value = (const Type*)(Source + Vertex * sizeof(TVertex<Type>));
+						short Encoded[2];
+						EncodeOctahedral(Value, Encoded);
+						if (Handed)
+						{
+							Encoded[1] = (short)((Encoded[1] & ~1) | (Value[3] < 0 ? 1 : 0));
+						}
+						memcpy(Destination + Vertex * Stride, Encoded, sizeof(Encoded));
+					}
+					break;
+				}
+
+				case THalf:
+				{
+					for (unsigned int Vertex = 0; Vertex < Count; Vertex++)
+					{
+						const Type* Value = (const Type*)(Source + Vertex * sizeof(TVertex<Type>));
+						unsigned short Encoded[4];
+						for (unsigned int Component = 0; Component < Lanes; Component++)
+						{
+							Encoded[Component] = FloatToHalf((float)Value[Component]);
+						}
+						memcpy(Destination + Vertex * Stride, Encoded, Lanes * sizeof(unsigned short));
+					}
+					break;
+				}
+
+				case TUNorm16:
+				{
+					Type Scale[2] = { 1 / UVRange[Set][0], 1 / UVRange[Set][1] };
+					for (unsigned int Vertex = 0; Vertex < Count; Vertex++)
+					{
+						const Type* Value = (const Type*)(Source + Vertex * sizeof(TVertex<Type>));
+						unsigned short Encoded[2];
+						for (unsigned int Component = 0; Component < 2; Component++)
+						{
+							Encoded[Component] = EncodeUNorm16((float)((Value[Component] - UVMin[Set][Component]) * Scale[Component]));
+						}
+						memcpy(Destination + Vertex * Stride, Encoded, sizeof(Encoded));
+					}
+					break;
+				}
+
+				case TUNorm8:
+				{
+					for (unsigned int Vertex = 0; Vertex < Count; Vertex++)
+					{
+						const Type* Value = (const Type*)(Source + Vertex * sizeof(TVertex<Type>));
+						unsigned char* Encoded = Destination + Vertex * Stride;
+						for (unsigned int Component = 0; Component < 4; Component++)
+						{
+							Encoded[Component] = EncodeUNorm8((float)Value[Component]);
+						}
+					}
+					break;
+				}
+
+				default:
+				{
+					for (unsigned int Vertex = 0; Vertex < Count; Vertex++)
+					{
+						memcpy(Destination + Vertex * Stride, Source + Vertex * sizeof(TVertex<Type>), Lanes * sizeof(Type));
+					}
+					break;
+				}
+			}
+		}
+
+		if (Errors != nullptr)
+		{
+			std::vector<TVertex<Type>> Decoded;
+			Unpack(Output.data(), Count, Decoded);
+			MeasureErrors(Vertices, Decoded, Errors);
+		}
+	}
+
+	//rebuilds full vertices from Count packed ones, attributes that are not
+	//in the layout come back as their Constants value
+	void Unpack(const unsigned char* Data, unsigned int Count, std::vector<TVertex<Type>>& Vertices) const
+	{
+		TVertex<Type> Defaults = TVertex<Type>();
+		Defaults.Position[3] = 1;
+		Defaults.FBXControlPointIndex = -1;
+		for (unsigned int Attribute = 0; Attribute < TAttributeCount; Attribute++)
+		{
+			memcpy((unsigned char*)&Defaults + SourceOffset(Attribute), Constants[Attribute], Components(Attribute) * sizeof(Type));
+		}
+
+		Vertices.assign(Count, Defaults);
+		for (unsigned int Attribute = 0; Attribute < TAttributeCount; Attribute++)
+		{
+			if (Offsets[Attribute] == TMissing)
+			{
+				continue;
+			}
+
+			const unsigned char* Source = Data + Offsets[Attribute];
+			unsigned char* Destination = (unsigned char*)Vertices.data() + SourceOffset(Attribute);
+			unsigned int Lanes = Components(Attribute);
+			unsigned int Set = (Attribute == 8) ? 1 : 0;
+
+			switch (Formats[Attribute])
+			{
+				case TSNorm16:
+				{
+					for (unsigned int Vertex = 0; Vertex < Count; Vertex++)
+					{
+						Type* Value = (Type*)(Destination + Vertex * sizeof(TVertex<Type>));
+						short Encoded[4];
+						memcpy(Encoded, Source + Vertex * Stride, sizeof(Encoded));
+						for (unsigned int Component = 0; Component < 3; Component++)
+						{
+							Value[Component] = PositionCenter[Component] + (Type)DecodeSNorm16(Encoded[Component]) * PositionExtent[Component];
+						}
+					}
+					break;
+				}
+
+				case TOctahedral16:
+				{
+					bool Handed = (Attribute == 3);
+					for (unsigned int Vertex = 0; Vertex < Count; Vertex++)
+					{
+						Type* Value = (Type*)(Destination + Vertex * sizeof(TVertex<Type>));
+						short Encoded[2];
+						memcpy(Encoded, Source + Vertex * Stride, sizeof(Encoded));
+						DecodeOctahedral(Encoded, Value);
+						if (Handed)
+						{
+							Value[3] = (Encoded[1] & 1) ? (Type)-1 : (Type)1;
+						}
+					}
+					break;
+				}
+
+				case THalf:
+				{
+					for (unsigned int Vertex = 0; Vertex < Count; Vertex++)
+					{
+						Type* Value = (Type*)(Destination + Vertex * sizeof(TVertex<Type>));
+						unsigned short Encoded[4];
+						memcpy(Encoded, Source + Vertex * Stride, Lanes * sizeof(unsigned short));
+						for (unsigned int Component = 0; Component < Lanes; Component++)
+						{
+							Value[Component] = (Type)HalfToFloat(Encoded[Component]);
+						}
+					}
+					break;
+				}
+
+				case TUNorm16:
+				{
+					for (unsigned int Vertex = 0; Vertex < Count; Vertex++)
+					{
+						Type* Value = (Type*)(Destination + Vertex * sizeof(TVertex<Type>));
+						unsigned short Encoded[2];
+						memcpy(Encoded, Source + Vertex * Stride, sizeof(Encoded));
+						for (unsigned int Component = 0; Component < 2; Component++)
+						{
+							Value[Component] = UVMin[Set][Component] + (Type)DecodeUNorm16(Encoded[Component]) * UVRange[Set][Component];
+						}
+					}
+					break;
+				}
+
+				case TUNorm8:
+				{
+					for (unsigned int Vertex = 0; Vertex < Count; Vertex++)
+					{
+						Type* Value = (Type*)(Destination + Vertex * sizeof(TVertex<Type>));
+						const unsigned char* Encoded = Source + Vertex * Stride;
+						for (unsigned int Component = 0; Component < 4; Component++)
+						{
+							Value[Component] = (Type)DecodeUNorm8(Encoded[Component]);
+						}
+					}
+					break;
+				}
+
+				default:
+				{
+					for (unsigned int Vertex = 0; Vertex < Count; Vertex++)
+					{
+						memcpy(Destination + Vertex * sizeof(TVertex<Type>), Source + Vertex * Stride, Lanes * sizeof(Type));
+					}
+					break;
+				}
+			}
+		}
+	}
+
+	//largest error of each packed attribute between Original and its Decoded round trip
+	void MeasureErrors(const std::vector<TVertex<Type>>& Original, const std::vector<TVertex<Type>>& Decoded, Type* Errors) const
+	{
+		for (unsigned int Attribute = 0; Attribute < TAttributeCount; Attribute++)
+		{
+			Errors[Attribute] = 0;
+			if (Offsets[Attribute] == TMissing)
+			{
+				continue;
+			}
+
+			unsigned int Offset = SourceOffset(Attribute);
+			unsigned int Lanes = Components(Attribute);
+
+			for (unsigned int Vertex = 0; Vertex < Original.size(); Vertex++)
+			{
+				const Type* Before = (const Type*)((const unsigned char*)&Original[Vertex] + Offset);
+				const Type* After = (const Type*)((const unsigned char*)&Decoded[Vertex] + Offset);
+
+				if (Formats[Attribute] == TOctahedral16)
+				{
+					Type Length = sqrt(Before[0] * Before[0] + Before[1] * Before[1] + Before[2] * Before[2]);
+					if (Length > 0)
+					{
+						Type Cosine = (Before[0] * After[0] + Before[1] * After[1] + Before[2] * After[2]) / Length;
+						Errors[Attribute] = std::max(Errors[Attribute], (Type)acos(std::min(std::max(Cosine, (Type)-1), (Type)1)));
+					}
+				}
+
+				else
+				{
+					for (unsigned int Component = 0; Component < Lanes; Component++)
+					{
+						Errors[Attribute] = std::max(Errors[Attribute], (Type)fabs(Before[Component] - After[Component]));
+					}
+				}
+			}
+		}
+	}
+
+	//TAttributes flags in the layout
+	unsigned int Attributes;
+	//bytes per packed vertex
+	unsigned int Stride;
+	//byte offset of each attribute in a packed vertex, TMissing when left out
+	unsigned int Offsets[TAttributeCount];
+	//TFormats of each attribute
+	unsigned int Formats[TAttributeCount];
+	//values of attributes Prune dropped for being the same everywhere
+	Type Constants[TAttributeCount][4];
+	//TSNorm16 positions decode to PositionCenter + Value * PositionExtent
+	Type PositionCenter[3];
+	Type PositionExtent[3];
+	//TUNorm16 uvs decode to UVMin + Value * UVRange, per uv set
+	Type UVMin[2][2];
+	Type UVRange[2][2];
+
+private:
+
+	//lays the attributes out in order from their formats
+	void Arrange()
+	{
+		Stride = 0;
+		for (unsigned int Attribute = 0; Attribute < TAttributeCount; Attribute++)
+		{
+			Offsets[Attribute] = TMissing;
+			if (Attributes & (1 << Attribute))
+			{
+				Offsets[Attribute] = Stride;
+				Stride += Size(Attribute);
+			}
+		}
+	}
+};
+
 template<typename Type>
 struct TMaterial
 {
@@ -108,6 +637,7 @@ public:
 	TNode() : NodeType(TNODE), Parent(nullptr), UserData(nullptr)
 	{
 		Name = new char[255];
+		Name[0] = '\0';
 		for(unsigned int TransformIter = 0; TransformIter < 4; TransformIter++)
 		{
 			LocalTransform[TransformIter * 5] = 1;
@@ -137,20 +667,223 @@ public:
 	void* UserData;
 };
 
-template<typename Type>
-class TMeshNode : public TNode<Type>
-{
-public:
+template<typename Type>
+class TMeshNode : public TNode<Type>
+{
+public:
+
+	TMeshNode() : Material(nullptr), SkinInfluences(0), SkinIndexBytes(0), SkinWeightBytes(0), BoundsRadius(0)
+	{
+		this->NodeType = TNode<Type>::TMESH;
+		memset(BoundsMin, 0, sizeof(BoundsMin));
+		memset(BoundsMax, 0, sizeof(BoundsMax));
+		memset(BoundsCenter, 0, sizeof(BoundsCenter));
+	}
+
+	virtual ~TMeshNode(){};
+
+	//layout of the Requested attributes, minus those that are constant on this mesh when Prune is set
+	TVertexLayout<Type> GetVertexLayout(unsigned int Requested = TVertexLayout<Type>::TAllAttributes, bool Prune = true) const
+	{
+		if (Prune)
+		{
+			return TVertexLayout<Type>::Prune(Vertices, Requested);
+		}
+
+		TVertexLayout<Type> Layout(Requested);
+		Layout.Fit(Vertices);
+		return Layout;
+	}
+
+	//Vertices packed and interleaved as Layout describes. Errors receives the
+	//quantization error of each attribute, see TVertexLayout::Pack
+	void ExportVertices(const TVertexLayout<Type>& Layout, std::vector<unsigned char>& Output, Type* Errors = nullptr) const
+	{
+		Layout.Pack(Vertices, Output, Errors);
+	}
+
+	//the local bounds carried through GlobalTransform
+	void GetWorldBounds(Type* Min, Type* Max) const
+	{
+		TransformBounds(BoundsMin, BoundsMax, this->GlobalTransform, Min, Max);
+	}
+
+	//moves Vertices into one stream per layout, for instance a position only
+	//stream followed by one holding everything else. attributes no layout
+	//holds are lost and Vertices is released, JoinStreams brings it back
+	void SplitStreams(const std::vector<TVertexLayout<Type>>& Layouts)
+	{
+		StreamLayouts = Layouts;
+		Streams.resize(Layouts.size());
+		for (unsigned int StreamIter = 0; StreamIter < Layouts.size(); StreamIter++)
+		{
+			Layouts[StreamIter].Pack(Vertices, Streams[StreamIter]);
+		}
+		std::vector<TVertex<Type>>().swap(Vertices);
+	}
+
+	//rebuilds Vertices from the streams SplitStreams made and releases them.
+	//attributes no stream holds come back as the last stream's Constants
+	void JoinStreams()
+	{
+		if (Streams.empty())
+		{
+			return;
+		}
+
+		unsigned int Last = Streams.size() - 1;
+		unsigned int Count = StreamLayouts[Last].Stride > 0 ? Streams[Last].size() / StreamLayouts[Last].Stride : 0;
+		StreamLayouts[Last].Unpack(Streams[Last].data(), Count, Vertices);
+
+		std::vector<TVertex<Type>> Stream;
+		for (unsigned int StreamIter = 0; StreamIter < Last; StreamIter++)
+		{
+			const TVertexLayout<Type>& Layout = StreamLayouts[StreamIter];
+			Layout.Unpack(Streams[StreamIter].data(), Count, Stream);
+
+			for (unsigned int Attribute = 0; Attribute < TVertexLayout<Type>::TAttributeCount; Attribute++)
+			{
+				if (Layout.Offsets[Attribute] == TVertexLayout<Type>::TMissing)
+				{
+					continue;
+				}
+
+				unsigned int Offset = TVertexLayout<Type>::SourceOffset(Attribute);
+				for (unsigned int Vertex = 0; Vertex < Count; Vertex++)
+				{
+					memcpy((unsigned char*)&Vertices[Vertex] + Offset, (const unsigned char*)&Stream[Vertex] + Offset, TVertexLayout<Type>::Components(Attribute) * sizeof(Type));
+				}
+			}
+		}
+
+		StreamLayouts.clear();
+		Streams.clear();
+	}
+
+	//rebuilds the 32 bit Indices and LODIndices from the 16 bit buffers
+	//TScene::NarrowIndices made and releases them
+	void WidenIndices()
+	{
+		if (ShortIndices.empty())
+		{
+			return;
+		}
+
+		Indices.resize(ShortIndices.size());
+		for (unsigned int RangeIter = 0; RangeIter < SubMeshes.size(); RangeIter++)
+		{
+			const TIndexRange& Range = SubMeshes[RangeIter];
+			for (unsigned int IndexIter = Range.IndexOffset; IndexIter < Range.IndexOffset + Range.IndexCount; IndexIter++)
+			{
+				Indices[IndexIter] = Range.VertexOffset + ShortIndices[IndexIter];
+			}
+		}
+
+		if (!ShortLODIndices.empty())
+		{
+			LODIndices.resize(ShortLODIndices.size());
+			for (unsigned int LODIter = 0; LODIter < ShortLODIndices.size(); LODIter++)
+			{
+				LODIndices[LODIter].assign(ShortLODIndices[LODIter].begin(), ShortLODIndices[LODIter].end());
+			}
+		}
+
+		std::vector<unsigned short>().swap(ShortIndices);
+		std::vector<std::vector<unsigned short>>().swap(ShortLODIndices);
+		SubMeshes.clear();
+	}
 
-	TMeshNode() : Material(nullptr)
+	//index of the stream holding an attribute flag, TMissing when there is none
+	unsigned int GetStream(unsigned int Attribute) const
 	{
-	   	//NodeType = TMESH;
+		for (unsigned int StreamIter = 0; StreamIter < StreamLayouts.size(); StreamIter++)
+		{
+			if (StreamLayouts[StreamIter].Attributes & Attribute)
+			{
+				return StreamIter;
+			}
+		}
+		return TVertexLayout<Type>::TMissing;
 	}
 
-	virtual ~TMeshNode(){};
 	TMaterial<Type>* Material;
 	std::vector<TVertex<Type>> Vertices;
 	std::vector<unsigned int> Indices;
+
+	//compact skin stream with SkinInfluences bones per vertex, strongest first.
+	//indices are SkinIndexBytes wide, weights are unorm SkinWeightBytes wide
+	unsigned int SkinInfluences;
+	unsigned int SkinIndexBytes;
+	unsigned int SkinWeightBytes;
+	std::vector<unsigned char> SkinIndices;
+	std::vector<unsigned char> SkinWeights;
+
+	//coarser index buffers over the same Vertices from TScene::GenerateLODs,
+	//each one simplified from the one before. LODErrors holds how far each
+	//may stray from the full mesh, relative to the mesh's largest extent
+	std::vector<std::vector<unsigned int>> LODIndices;
+	std::vector<Type> LODErrors;
+
+	//clusters of Indices from TScene::GenerateMeshlets for coarse culling.
+	//bounds are in the mesh's own space, and in bind pose for skinned meshes
+	std::vector<TMeshlet<Type>> Meshlets;
+	std::vector<unsigned int> MeshletVertices;
+	std::vector<unsigned char> MeshletTriangles;
+
+	//triangle BVH in the mesh's own space from TScene::GenerateBVH, for ray and closest point queries
+	TMeshBVH<Type> BVH;
+
+	//local space box and sphere around Vertices, found once on import
+	Type BoundsMin[3];
+	Type BoundsMax[3];
+	Type BoundsCenter[3];
+	Type BoundsRadius;
+
+	//post transform cache figures from TScene::OptimizeMesh, before and after reordering
+	TVertexCacheStats CacheStatsBefore;
+	TVertexCacheStats CacheStatsAfter;
+
+	//deinterleaved vertex data from SplitStreams, Vertices is empty while these are in use
+	std::vector<TVertexLayout<Type>> StreamLayouts;
+	std::vector<std::vector<unsigned char>> Streams;
+
+	//16 bit index buffers from TScene::NarrowIndices, Indices is empty while
+	//these are in use. ShortIndices are relative to the VertexOffset of the
+	//SubMeshes range drawing them. LODs are only narrowed into ShortLODIndices
+	//when the whole mesh fits in one range, otherwise LODIndices stays 32 bit
+	std::vector<unsigned short> ShortIndices;
+	std::vector<std::vector<unsigned short>> ShortLODIndices;
+	std::vector<TIndexRange> SubMeshes;
+
+	//copies everything above except Material from Other, for instances of a
+	//mesh that was only extracted once. a field added to TMeshNode belongs here too
+	void CopyGeometry(const TMeshNode& Other)
+	{
+		Vertices = Other.Vertices;
+		Indices = Other.Indices;
+		SkinInfluences = Other.SkinInfluences;
+		SkinIndexBytes = Other.SkinIndexBytes;
+		SkinWeightBytes = Other.SkinWeightBytes;
+		SkinIndices = Other.SkinIndices;
+		SkinWeights = Other.SkinWeights;
+		LODIndices = Other.LODIndices;
+		LODErrors = Other.LODErrors;
+		Meshlets = Other.Meshlets;
+		MeshletVertices = Other.MeshletVertices;
+		MeshletTriangles = Other.MeshletTriangles;
+		BVH = Other.BVH;
+		memcpy(BoundsMin, Other.BoundsMin, sizeof(BoundsMin));
+		memcpy(BoundsMax, Other.BoundsMax, sizeof(BoundsMax));
+		memcpy(BoundsCenter, Other.BoundsCenter, sizeof(BoundsCenter));
+		BoundsRadius = Other.BoundsRadius;
+		CacheStatsBefore = Other.CacheStatsBefore;
+		CacheStatsAfter = Other.CacheStatsAfter;
+		StreamLayouts = Other.StreamLayouts;
+		Streams = Other.Streams;
+		ShortIndices = Other.ShortIndices;
+		ShortLODIndices = Other.ShortLODIndices;
+		SubMeshes = Other.SubMeshes;
+	}
 };
 
 template<typename Type>
@@ -158,7 +891,10 @@ class TLightNode : public TNode<Type>
 {
 public:
 
-	TLightNode(){};//) : NodeType(TLIGHT){};
+	TLightNode()
+	{
+		this->NodeType = TNode<Type>::TLIGHT;
+	}
 	virtual ~TLightNode(){};
 
 	enum TLightType
@@ -183,7 +919,10 @@ class TCameraNode : public TNode<Type>
 {
 public:
 
-	TCameraNode(){};// : NodeType(TCAMERA){};
+	TCameraNode()
+	{
+		this->NodeType = TNode<Type>::TCAMERA;
+	}
 	virtual ~TCameraNode(){};
 
 	Type AspectRatio;
@@ -209,17 +948,312 @@ public:
 	Type Scale[4];
 };
 
+//a track packed into a smaller working set. keys are stored as 16 bit deltas
+//with an absolute key at the start of every block to search on, rotations are
+//smallest three quaternions in 48 bits and translation and scale are 16 bits
+//inside the track's own range
+template<typename Type>
+struct TCompressedTrack
+{
+	enum
+	{
+		BlockSize = 32
+	};
+
+	TCompressedTrack()
+	{
+		memset(TranslationMin, 0, sizeof(Type) * 3);
+		memset(TranslationRange, 0, sizeof(Type) * 3);
+		memset(ScaleMin, 0, sizeof(Type) * 3);
+		memset(ScaleRange, 0, sizeof(Type) * 3);
+	}
+
+	std::vector<unsigned int> BlockKeys;
+	std::vector<unsigned short> KeyDeltas;
+
+	//3 shorts per key each
+	std::vector<unsigned short> Rotations;
+	std::vector<unsigned short> Translations;
+	std::vector<unsigned short> Scales;
+
+	Type TranslationMin[3];
+	Type TranslationRange[3];
+	Type ScaleMin[3];
+	Type ScaleRange[3];
+};
+
 template<typename Type>
 class TTrack
 {
 public:
-	TTrack() : BoneIndex(0), KeyFrameCount(0), KeyFrames(nullptr){};
+	TTrack() : BoneIndex(0), KeyFrameCount(0), KeyFrames(nullptr), Compressed(nullptr){};
 	~TTrack(){};
 
+	//packs the key frames into Compressed and frees them. leaves the track as
+	//it is if two neighbouring keys are more than 65535 frames apart
+	bool Compress()
+	{
+		if (Compressed != nullptr || KeyFrameCount == 0)
+		{
+			return Compressed != nullptr;
+		}
+
+		for (unsigned int KeyIter = 1; KeyIter < KeyFrameCount; KeyIter++)
+		{
+			if (KeyFrames[KeyIter].Key - KeyFrames[KeyIter - 1].Key > 0xffff)
+			{
+				return false;
+			}
+		}
+
+		TCompressedTrack<Type>* Packed = new TCompressedTrack<Type>();
+
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			Type TranslationMax = KeyFrames[0].Translation[Component];
+			Type ScaleMax = KeyFrames[0].Scale[Component];
+			Packed->TranslationMin[Component] = TranslationMax;
+			Packed->ScaleMin[Component] = ScaleMax;
+
+			for (unsigned int KeyIter = 1; KeyIter < KeyFrameCount; KeyIter++)
+			{
+				Packed->TranslationMin[Component] = std::min(Packed->TranslationMin[Component], KeyFrames[KeyIter].Translation[Component]);
+				Packed->ScaleMin[Component] = std::min(Packed->ScaleMin[Component], KeyFrames[KeyIter].Scale[Component]);
+				TranslationMax = std::max(TranslationMax, KeyFrames[KeyIter].Translation[Component]);
+				ScaleMax = std::max(ScaleMax, KeyFrames[KeyIter].Scale[Component]);
+			}
+
+			Packed->TranslationRange[Component] = TranslationMax - Packed->TranslationMin[Component];
+			Packed->ScaleRange[Component] = ScaleMax - Packed->ScaleMin[Component];
+		}
+
+		Packed->BlockKeys.resize((KeyFrameCount + TCompressedTrack<Type>::BlockSize - 1) / TCompressedTrack<Type>::BlockSize);
+		Packed->KeyDeltas.resize(KeyFrameCount);
+		Packed->Rotations.resize(KeyFrameCount * 3);
+		Packed->Translations.resize(KeyFrameCount * 3);
+		Packed->Scales.resize(KeyFrameCount * 3);
+
+		for (unsigned int KeyIter = 0; KeyIter < KeyFrameCount; KeyIter++)
+		{
+			const TKeyFrame<Type>& KeyFrame = KeyFrames[KeyIter];
+
+			if (KeyIter % TCompressedTrack<Type>::BlockSize == 0)
+			{
+				Packed->BlockKeys[KeyIter / TCompressedTrack<Type>::BlockSize] = KeyFrame.Key;
+				Packed->KeyDeltas[KeyIter] = 0;
+			}
+			else
+			{
+				Packed->KeyDeltas[KeyIter] = (unsigned short)(KeyFrame.Key - KeyFrames[KeyIter - 1].Key);
+			}
+
+			PackQuaternion(KeyFrame.Rotation, &Packed->Rotations[KeyIter * 3]);
+
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				Packed->Translations[KeyIter * 3 + Component] = QuantizeRange(KeyFrame.Translation[Component],
+					Packed->TranslationMin[Component], Packed->TranslationRange[Component]);
+				Packed->Scales[KeyIter * 3 + Component] = QuantizeRange(KeyFrame.Scale[Component],
+					Packed->ScaleMin[Component], Packed->ScaleRange[Component]);
+			}
+		}
+
+		delete[] KeyFrames;
+		KeyFrames = nullptr;
+		Compressed = Packed;
+		return true;
+	}
+
+	unsigned int GetKey(unsigned int Index) const
+	{
+		if (Compressed == nullptr)
+		{
+			return KeyFrames[Index].Key;
+		}
+
+		unsigned int Block = Index / TCompressedTrack<Type>::BlockSize;
+		unsigned int Key = Compressed->BlockKeys[Block];
+		for (unsigned int KeyIter = Block * TCompressedTrack<Type>::BlockSize + 1; KeyIter <= Index; KeyIter++)
+		{
+			Key += Compressed->KeyDeltas[KeyIter];
+		}
+		return Key;
+	}
+
+	//copies out key frame Index, decoding it if the track is compressed
+	void GetKeyFrame(unsigned int Index, TKeyFrame<Type>& KeyFrame) const
+	{
+		if (Compressed == nullptr)
+		{
+			KeyFrame = KeyFrames[Index];
+			return;
+		}
+
+		KeyFrame.Key = GetKey(Index);
+		UnpackQuaternion(&Compressed->Rotations[Index * 3], KeyFrame.Rotation);
+
+		const unsigned short* Translation = &Compressed->Translations[Index * 3];
+		const unsigned short* Scale = &Compressed->Scales[Index * 3];
+		const Type Step = (Type)1 / 65535;
+
+		//kept as straight lane loops so the three components decode side by side
+		for (unsigned int Component = 0; Component < 3; Component++)
+		{
+			KeyFrame.Translation[Component] = Compressed->TranslationMin[Component] + Translation[Component] * Step * Compressed->TranslationRange[Component];
+			KeyFrame.Scale[Component] = Compressed->ScaleMin[Component] + Scale[Component] * Step * Compressed->ScaleRange[Component];
+		}
+		KeyFrame.Translation[3] = 1;
+		KeyFrame.Scale[3] = 1;
+	}
+
+	//index of the last key at or before Frame, 0 when Frame comes before every key
+	unsigned int FindKeyFrame(Type Frame) const
+	{
+		if (KeyFrameCount == 0)
+		{
+			return 0;
+		}
+
+		if (Compressed == nullptr)
+		{
+			unsigned int First = 0;
+			unsigned int Count = KeyFrameCount;
+			while (Count > 0)
+			{
+				unsigned int Half = Count / 2;
+				if ((Type)KeyFrames[First + Half].Key <= Frame)
+				{
+					First += Half + 1;
+					Count -= Half + 1;
+				}
+				else
+				{
+					Count = Half;
+				}
+			}
+			return (First > 0) ? First - 1 : 0;
+		}
+
+		//binary search the blocks then walk the deltas inside the one found
+		unsigned int First = 0;
+		unsigned int Count = Compressed->BlockKeys.size();
+		while (Count > 0)
+		{
+			unsigned int Half = Count / 2;
+			if ((Type)Compressed->BlockKeys[First + Half] <= Frame)
+			{
+				First += Half + 1;
+				Count -= Half + 1;
+			}
+			else
+			{
+				Count = Half;
+			}
+		}
+
+		unsigned int Block = (First > 0) ? First - 1 : 0;
+		unsigned int Index = Block * TCompressedTrack<Type>::BlockSize;
+		unsigned int Key = Compressed->BlockKeys[Block];
+
+		while (Index + 1 < KeyFrameCount && (Index + 1) % TCompressedTrack<Type>::BlockSize != 0 &&
+			(Type)(Key + Compressed->KeyDeltas[Index + 1]) <= Frame)
+		{
+			Index++;
+			Key += Compressed->KeyDeltas[Index];
+		}
+		return Index;
+	}
+
+	//drops every key that interpolating its kept neighbours rebuilds within the
+	//tolerances. RotationTolerance is in radians. the first and last keys always stay
+	void Reduce(Type RotationTolerance, Type TranslationTolerance, Type ScaleTolerance)
+	{
+		if (KeyFrameCount < 3 || Compressed != nullptr)
+		{
+			return;
+		}
+
+		std::vector<unsigned int> Kept;
+		Kept.push_back(0);
+
+		unsigned int Anchor = 0;
+		for (unsigned int Candidate = 2; Candidate < KeyFrameCount; Candidate++)
+		{
+			if (!Reconstructs(Anchor, Candidate, RotationTolerance, TranslationTolerance, ScaleTolerance))
+			{
+				Anchor = Candidate - 1;
+				Kept.push_back(Anchor);
+			}
+		}
+		Kept.push_back(KeyFrameCount - 1);
+
+		if (Kept.size() == KeyFrameCount)
+		{
+			return;
+		}
+
+		TKeyFrame<Type>* Reduced = new TKeyFrame<Type>[Kept.size()];
+		for (unsigned int KeptIter = 0; KeptIter < Kept.size(); KeptIter++)
+		{
+			Reduced[KeptIter] = KeyFrames[Kept[KeptIter]];
+		}
+
+		delete[] KeyFrames;
+		KeyFrames = Reduced;
+		KeyFrameCount = Kept.size();
+	}
+
+	//whether every key between First and Last is rebuilt by interpolating those two
+	bool Reconstructs(unsigned int First, unsigned int Last,
+		Type RotationTolerance, Type TranslationTolerance, Type ScaleTolerance) const
+	{
+		const TKeyFrame<Type>& Start = KeyFrames[First];
+		const TKeyFrame<Type>& End = KeyFrames[Last];
+		Type Span = (Type)(End.Key - Start.Key);
+		Type CosTolerance = cos(std::min(RotationTolerance, (Type)PI) * (Type)0.5);
+
+		for (unsigned int KeyIter = First + 1; KeyIter < Last; KeyIter++)
+		{
+			const TKeyFrame<Type>& Key = KeyFrames[KeyIter];
+			Type T = (Span > 0) ? (Type)(Key.Key - Start.Key) / Span : 0;
+
+			Type Rotation[4];
+			Slerp(Start.Rotation, End.Rotation, T, Rotation);
+			Type Dot = fabs(Rotation[0] * Key.Rotation[0] + Rotation[1] * Key.Rotation[1] +
+				Rotation[2] * Key.Rotation[2] + Rotation[3] * Key.Rotation[3]);
+			if (Dot < CosTolerance)
+			{
+				return false;
+			}
+
+			Type Distance = 0;
+			for (unsigned int Component = 0; Component < 3; Component++)
+			{
+				Type Translation = Start.Translation[Component] + (End.Translation[Component] - Start.Translation[Component]) * T;
+				Type Scale = Start.Scale[Component] + (End.Scale[Component] - Start.Scale[Component]) * T;
+				Distance += (Translation - Key.Translation[Component]) * (Translation - Key.Translation[Component]);
+
+				if (fabs(Scale - Key.Scale[Component]) > ScaleTolerance)
+				{
+					return false;
+				}
+			}
+
+			if (Distance > TranslationTolerance * TranslationTolerance)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
 	unsigned int BoneIndex;
 	unsigned int KeyFrameCount;
 	TKeyFrame<Type>* KeyFrames;
 
+	//set instead of KeyFrames once the track is compressed
+	TCompressedTrack<Type>* Compressed;
+
 };
 
 template<typename Type>
@@ -253,11 +1287,13 @@ public:
 
 	~TSkeleton()
 	{
-		delete Nodes;
-		delete Bones;
-		delete BindPoses;
+		delete[] Nodes;
+		delete[] Bones;
+		delete[] BindPoses;
 	}
 
+	//poses the bones at Time seconds into Animation and leaves the skinning
+	//matrices in Bones
 	void Evaluate(const TAnimation<Type>* Animation,
 		float Time, bool Looping = true, float FPS = 24.0f)
 	{
@@ -267,162 +1303,120 @@ public:
 			float AnimationDuration = AnimationFrames / FPS;
 
 			float FrameTime = 0;
-			if (Looping)
-			{
-				FrameTime = Maxf(fmod(Time, AnimationDuration), 0);
-			}
-			else
+			if (AnimationDuration > 0)
 			{
-				FrameTime = Minf(Maxf(Time, 0), AnimationDuration);
+				if (Looping)
+				{
+					FrameTime = Maxf(fmod(Time, AnimationDuration), 0);
+				}
+				else
+				{
+					FrameTime = Minf(Maxf(Time, 0), AnimationDuration);
+				}
 			}
 
-			unsigned int Frame = Animation->StartFrame + (int)(FrameTime * FPS);
+			Type Frame = (Type)(Animation->StartFrame + FrameTime * FPS);
 
-			const TTrack<Type>* Track = nullptr;
-			const TKeyFrame<Type>* Start = nullptr;
-			const TKeyFrame<Type>* End = nullptr;
+			TKeyFrame<Type> Start;
+			TKeyFrame<Type> End;
 
-			for (unsigned int i = 0; i < Animation->TrackCount;
-				i++, Track = &(Animation->Tracks[i]), Start = nullptr, End = nullptr)
+			for (unsigned int i = 0; i < Animation->TrackCount; i++)
 			{
-				for (unsigned int j = 0; j < Track->KeyFrameCount - 1; j++)
+				const TTrack<Type>* Track = &(Animation->Tracks[i]);
+				if (Track->KeyFrameCount == 0 || Track->BoneIndex >= BoneCount)
 				{
-					if (Track->KeyFrames[j].Key <= Frame &&
-						Track->KeyFrames[j + 1].Key >= Frame)
-					{
-						Start = &(Track->KeyFrames[j]);
-						End = &(Track->KeyFrames[j + 1]);
-						break;
-					}
+					continue;
 				}
 
-				if (Start != nullptr && End != nullptr)
-				{
-					float StartTime = (Start->Key - Animation->StartFrame) / FPS;
-					float EndTime = (End->Key - Animation->StartFrame) / FPS;
-
-					float FScale = Maxf(0, Minf(1, (FrameTime - StartTime) / (EndTime - StartTime)));
-
-					Type Transform[4];
-					Type Scale[4];
-
-					for (unsigned int j = 0; j < 4; j++)
-					{
-						Transform[j] = Start->Translation[j] * (1 - FScale) + End->Translation[j] * FScale;
-						Scale[j] = Start->Scale[j] * (1 - FScale) + End->Scale[j] * FScale;
-					}
-
-					FbxQuaternion QStart(Start->Rotation[0], Start->Rotation[1], Start->Rotation[2], Start->Rotation[3]);
-					FbxQuaternion QEnd(End->Rotation[0], End->Rotation[1], End->Rotation[2], End->Rotation[3]);
-					FbxQuaternion QRotation;
-
-					double CosHalfTheta = QStart[3] * QEnd[3] + QStart[0] * QEnd[0] + QStart[1] * QEnd[1] + QStart[2] * QEnd[2];
-
-					if (abs(CosHalfTheta) >= 1.0)
-					{
-						for (unsigned int j = 0; j < 4; j++)
-						{
-							QRotation[j] = QStart[j];
-						}
-					}
-
-					else
-					{
-						double HalfTheta = acos(CosHalfTheta);
-						double SinHalfTheta = sqrt(1.0 - CosHalfTheta * CosHalfTheta);
-
-						if (fabs(SinHalfTheta) < 0.0001)
-						{
-							for (unsigned int j = 0; j < 4; j++)
-							{
-								QRotation[j] = (QStart[j] * 0.5 + QEnd[j] * 0.5);
-							}
-						}
-						else
-						{
-							double RatioA = sin((1 - FScale) * HalfTheta) / SinHalfTheta;
-							double RatioB = sin(FScale * HalfTheta) / SinHalfTheta;
-							for (int j = 0; j < 4; j++)
-							{
-								QRotation[j] = (QStart[j] * RatioA + QEnd[j] * RatioB);
-							}
-						}
-
-						QRotation.Normalize();
-
-						FbxAMatrix Matrix;
-						Matrix.SetTQS(FbxVector4(Transform[0], Transform[1], Transform[3]), QRotation, FbxVector4(Scale[0], Scale[1], Scale[2]));
+				unsigned int StartIndex = Track->FindKeyFrame(Frame);
+				unsigned int EndIndex = std::min(StartIndex + 1, Track->KeyFrameCount - 1);
+				Track->GetKeyFrame(StartIndex, Start);
+				Track->GetKeyFrame(EndIndex, End);
 
-						FbxVector4 Row0 = Matrix.GetRow(0);
-						FbxVector4 Row1 = Matrix.GetRow(1);
-						FbxVector4 Row2 = Matrix.GetRow(2);
-						FbxVector4 Row3 = Matrix.GetRow(3);
+				Type Span = (Type)End.Key - (Type)Start.Key;
+				Type FScale = (Span > 0) ? (Frame - (Type)Start.Key) / Span : 0;
+				FScale = std::max((Type)0, std::min((Type)1, FScale));
 
-						for (unsigned int j = 0; j < 4; j++)
-						{
-							for (unsigned int k = 0; k < 4; k++)
-							{
-								switch (j)
-								{
-								case 0:
-								{
-									Nodes[Track->BoneIndex]->LocalTransform[j * k] = (Type)Row0[k];
-									break;
-								}
-
-								case 1:
-								{
-									Nodes[Track->BoneIndex]->LocalTransform[j * k] = (Type)Row1[k];
-									break;
-								}
-
-								case 2:
-								{
-									Nodes[Track->BoneIndex]->LocalTransform[j * k] = (Type)Row2[k];
-									break;
-								}
-
-								case 3:
-								{
-									Nodes[Track->BoneIndex]->LocalTransform[j * k] = (Type)Row3[k];
-									break;
-								}
-								default:
-								{
-									break;
-								}
-								}								
-							}
-						}
-						if (Nodes[Track->BoneIndex]->Parent != nullptr)
-						{
-							Nodes[Track->BoneIndex]->GlobalTransform = Nodes[Track->BoneIndex]->LocalTransform * Nodes[Track->BoneIndex]->Parent->GlobalTransform;
-						}
+				Type Rotation[4];
+				Type Translation[3];
+				Type Scale[3];
 
-						else
-						{
-							Nodes[Track->BoneIndex]->GlobalTransform = Nodes[Track->BoneIndex]->LocalTransform;
-						}
-					}
+				Slerp(Start.Rotation, End.Rotation, FScale, Rotation);
+				for (unsigned int j = 0; j < 3; j++)
+				{
+					Translation[j] = Start.Translation[j] * (1 - FScale) + End.Translation[j] * FScale;
+					Scale[j] = Start.Scale[j] * (1 - FScale) + End.Scale[j] * FScale;
 				}
+
+				ComposeTransform(Translation, Rotation, Scale, Nodes[Track->BoneIndex]->LocalTransform);
 			}
 		}
-		static Type Matrix[16] = { 1, 0, 0, 0, 1, 0, 0, 0, -1, 0, 0, 0, 1 };
 
+		//undoes the z flip the scene root applies so skinning happens in model space
+		static const Type Matrix[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, -1, 0, 0, 0, 0, 1 };
+
+		//bones are stored parents first so each parent is posed before its children
 		for (unsigned int i = 0; i < BoneCount; i++)
 		{
-			//make a function to multiply matrices together.
-			Bones[i] = BindPoses[i] * Nodes[i]->GlobalTransform * Matrix;
+			TNode<Type>* Node = Nodes[i];
+			if (Node->Parent != nullptr)
+			{
+				MultiplyMatrix(Node->LocalTransform, Node->Parent->GlobalTransform, Node->GlobalTransform);
+			}
+			else
+			{
+				memcpy(Node->GlobalTransform, Node->LocalTransform, sizeof(Type) * 16);
+			}
+
+			Type Pose[16];
+			MultiplyMatrix(BindPoses[i], Node->GlobalTransform, Pose);
+			MultiplyMatrix(Pose, Matrix, Bones[i]);
 		}
 	}
 
 	unsigned int BoneCount;
 	TNode<Type>** Nodes;
-	Type** Bones;
-	Type** BindPoses;
+	Type (*Bones)[16];
+	Type (*BindPoses)[16];
 	void* UserData;
 };
 
+//resolves which direct array element each polygon corner uses for one
+//mapping/reference pair. both modes are template arguments so every test
+//below folds away and the loop compiles down to a plain gather. anything
+//out of range falls back to the layer's default element
+template<FbxGeometryElement::EMappingMode Mapping, FbxGeometryElement::EReferenceMode Reference>
+struct TLayerDecoder
+{
+	static void Decode(const int* CornerControlPoints, const int* CornerPolygons, int CornerCount,
+		const int* IndexArray, int IndexCount, int Fallback, int* Elements)
+	{
+		for (int Corner = 0; Corner < CornerCount; Corner++)
+		{
+			int Index = 0;
+			if (Mapping == FbxGeometryElement::eByControlPoint)
+			{
+				Index = CornerControlPoints[Corner];
+			}
+			else if (Mapping == FbxGeometryElement::eByPolygonVertex)
+			{
+				Index = Corner;
+			}
+			else if (Mapping == FbxGeometryElement::eByPolygon)
+			{
+				Index = CornerPolygons[Corner];
+			}
+
+			if (Reference == FbxGeometryElement::eIndexToDirect)
+			{
+				Index = ((unsigned int)Index < (unsigned int)IndexCount) ? IndexArray[Index] : Fallback;
+			}
+
+			Elements[Corner] = ((unsigned int)Index < (unsigned int)Fallback) ? Index : Fallback;
+		}
+	}
+};
+
 template<typename Type>
 struct TScene
 {
@@ -430,131 +1424,84 @@ struct TScene
 	{
 		Root = nullptr;
 		Assistor = new ImportAssistor();
+		WeldEpsilon = 0;
+		ParallelExtraction = true;
+		ThreadCount = 0;
+		MaxInfluences = 4;
+		SkinWeightBytes = 1;
+		AnimationFrameRate = 0;
+		ReduceKeyFrames = false;
+		RotationTolerance = (Type)0.001;
+		TranslationTolerance = (Type)0.01;
+		ScaleTolerance = (Type)0.001;
+		CompressTracks = false;
+		OptimizeVertexOrder = false;
+		VertexCacheSize = 16;
+		ReduceOverdraw = false;
+		OverdrawThreshold = (Type)1.05;
+		LODCount = 0;
+		LODReduction = (Type)0.5;
+		LODTargetError = (Type)0.01;
+		SplitMeshlets = false;
+		MeshletMaxVertices = 64;
+		MeshletMaxTriangles = 124;
+		BuildMeshBVHs = false;
+		SplitVertexStreams = false;
+		CompressStreams = false;
+		NarrowIndexBuffers = false;
+		SplitLargeMeshes = false;
+		CompressIndices = false;
+		CompressVertices = false;
 	}
 	
 	TMeshNode<Type>* GetMeshByName(const char* Name)
 	{
-		auto MeshIter = Meshes.find(Name);
-		if (MeshIter != Meshes.end())
-		{
-			return MeshIter->second();
-		}
-		return nullptr;
+		return Meshes.Find(Name);
 	}
 
 	TLightNode<Type>* GetLightByName(const char* Name)
 	{
-		auto LightIter = Lights.find(Name);
-		if (LightIter != Lights.end())
-		{
-			return LightIter->second();
-		}
-		return nullptr;
+		return Lights.Find(Name);
 	}
 
 	TCameraNode<Type>* GetCameraByName(const char* Name)
 	{
-		auto CameraIter = Cameras.find(Name);
-		if (CameraIter != Cameras.end())
-		{
-			return CameraIter->second;
-		}
-		return nullptr;
+		return Cameras.Find(Name);
 	}
 
 	TMaterial<Type>* GetMaterialByName(const char* Name)
 	{
-		auto MaterialIter = Materials.find(Name);
-		if (MaterialIter != Materials.end())
-		{
-			return MaterialIter->second;
-		}
-		return nullptr;
+		return Materials.Find(Name);
 	}
 
 	TAnimation<Type>* GetAnimationByName(const char* Name)
 	{
-		auto AnimationIter = Animations.find(Name);
-		if (AnimationIter != Animations.end())
-		{
-			return AnimationIter->second;
-		}
-		return nullptr;
+		return Animations.Find(Name);
 	}
 
 	TMeshNode<Type>* GetMeshByIndex(unsigned int Index)
 	{
-		TMeshNode<Type>* NewMesh = nullptr;
-		auto MeshIter = Meshes.begin();
-		unsigned int Size = Meshes.size();
-
-		for (unsigned int IndexIter = 0;
-			IndexIter <= Index && Index < Size;
-			IndexIter++, MeshIter++)
-		{
-			NewMesh = MeshIter->second;
-		}
-		return NewMesh;
+		return Meshes.Get(Index);
 	}
 
 	TLightNode<Type>* GetLightByIndex(unsigned int Index)
 	{
-		TLightNode<Type>* NewLight = nullptr;
-		auto LightIter = Lights.begin();
-		unsigned int Size = Lights.size();
-
-		for (unsigned int IndexIter = 0;
-			IndexIter <= Index && Index < Size;
-			IndexIter++, LightIter++)
-		{
-			NewLight = LightIter->second;
-		}
-		return NewLight;
+		return Lights.Get(Index);
 	}
 
 	TCameraNode<Type>* GetCameraByIndex(unsigned int Index)
 	{
-		TCameraNode<Type>* NewCamera = nullptr;
-		auto CameraIter = Cameras.begin();
-		unsigned int Size = Cameras.size();
-
-		for (unsigned int IndexIter = 0;
-			IndexIter <= Index && Index < Size;
-			IndexIter++, CameraIter++)
-		{
-			NewCamera = CameraIter->second;
-		}
-		return NewCamera;
+		return Cameras.Get(Index);
 	}
 
 	TMaterial<Type>* GetMaterialByIndex(unsigned int Index)
 	{
-		TMaterial<Type>* NewMaterial = nullptr;
-		auto MaterialIter = Materials.begin();
-		unsigned int Size = Materials.size();
-
-		for (unsigned int IndexIter = 0;
-			IndexIter <= Index && Index < Size;
-			IndexIter++, MaterialIter++)
-		{
-			NewMaterial = MaterialIter->second;
-		}
-		return NewMaterial;
+		return Materials.Get(Index);
 	}
 
 	TAnimation<Type>* GetAnimationByIndex(unsigned int Index)
 	{
-		TAnimation<Type>* NewAnimation = nullptr;
-		auto AnimationIter = Animations.begin();
-		unsigned int Size = Animations.size();
-
-		for (unsigned int IndexIter = 0;
-			IndexIter <= Index && Index < Size;
-			IndexIter++, AnimationIter++)
-		{
-			NewAnimation = AnimationIter->second;
-		}
-		return NewAnimation;
+		return Animations.Get(Index);
 	}
 
 	void Unload()
@@ -584,39 +1531,46 @@ struct TScene
 		{
 			for (unsigned int AnimationIter = 0; AnimationIter < Iter->TrackCount; AnimationIter++)
 			{
-				delete[] Iter.second->Tracks[AnimationIter].KeyFrames;
-				delete[] Iter.second->Tracks;
-				delete Iter.second;
+				delete[] Iter->Tracks[AnimationIter].KeyFrames;
+				delete Iter->Tracks[AnimationIter].Compressed;
 			}
+			delete[] Iter->Tracks;
+			delete Iter;
 		}
 
-		Meshes.clear();
-		Lights.clear();
-		Cameras.clear();
-		Materials.clear();
-		Animations.clear();
+		Meshes.Clear();
+		Lights.Clear();
+		Cameras.Clear();
+		Materials.Clear();
+		Animations.Clear();
 
 		Skeletons.clear();
+		MeshBounds.Resize(0);
+		SceneBVH.Clear();
+		SceneBVHNodes.clear();
+		SceneBVHIndices.clear();
+
+		Assistor->Bones.clear();
+		Assistor->BoneIndices.Clear();
+		Assistor->BoneCount = 0;
 	}
 
 	void CollectBones(void* Objects)
 	{
 		FbxNode* NewNode = (FbxNode*)Objects;
 
+		//numbered in the same depth first order ExtractObject fills Assistor->Bones in
 		if (NewNode->GetNodeAttribute() != nullptr &&
 			NewNode->GetNodeAttribute()->GetAttributeType() ==
 			FbxNodeAttribute::eSkeleton)
 		{
-			unsigned int Index = Assistor->BoneIndexMap.size();
-
-			char Name[255];
-			strncpy(Name, NewNode->GetName(), 255);
-			Assistor->BoneIndexMap[Name] = Index;
+			Assistor->BoneIndices.Insert(NewNode->GetName(), Assistor->BoneCount++);
+		}
 
-			for (int ChildIter = 0; ChildIter < NewNode->GetChildCount(); ChildIter++)
-			{
-				CollectBones((void*)NewNode->GetChild(ChildIter));
-			}
+		//bones can sit below plain transform nodes so every branch is walked
+		for (int ChildIter = 0; ChildIter < NewNode->GetChildCount(); ChildIter++)
+		{
+			CollectBones((void*)NewNode->GetChild(ChildIter));
 		}
 	}
 
@@ -708,27 +1662,44 @@ struct TScene
 				ExtractObject(Root, (void*)RootNode->GetChild(Iter));
 			}
 
+			ExtractPendingMeshes();
+
 			if (Assistor->Bones.size() > 0)
 			{
 				TSkeleton<Type>* Skeleton = new TSkeleton<Type>();
 				Skeleton->BoneCount = Assistor->Bones.size();
 				Skeleton->Nodes = new TNode<Type>*[Skeleton->BoneCount];
-				memset(Skeleton->Bones, 0, (sizeof(Type) * 16) * Skeleton->BoneCount);
-				memset(Skeleton->BindPoses, 0, (sizeof(Type) * 16) * Skeleton->BoneCount);
+				Skeleton->Bones = new Type[Skeleton->BoneCount][16];
+				Skeleton->BindPoses = new Type[Skeleton->BoneCount][16];
+				const Type Identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
 
 				for (Iter = 0; Iter < Skeleton->BoneCount; Iter++)
 				{
 					Skeleton->Nodes[Iter] = Assistor->Bones[Iter];
-					Skeleton->Bones[Iter] = Skeleton->Nodes[Iter]->LocalTransform;
+					memcpy(Skeleton->Bones[Iter], Skeleton->Nodes[Iter]->LocalTransform, sizeof(Type) * 16);
+					memcpy(Skeleton->BindPoses[Iter], Identity, sizeof(Type) * 16);
 				}
 
 				ExtractSkeleton(Skeleton, Scene);
 				Skeletons.push_back(Skeleton);
 				ExtractAnimation(Scene);
+
+				if (ReduceKeyFrames)
+				{
+					ReduceAnimations();
+				}
+
+				if (CompressTracks)
+				{
+					CompressAnimations();
+				}
 			}
 		}
 		Manager->Destroy();
+		UpdateWorldBounds();
+		BuildSceneBVH();
 		Path = (char*)FileName;
+		return true;
 	}
 
 	void ExtractObject(TNode<Type>* Parent, void* Object)
@@ -760,12 +1731,19 @@ struct TScene
 				case FbxNodeAttribute::eMesh:
 				{
 					TinyNode = new TMeshNode<Type>();
-					ExtractMesh((TMeshNode<Type>*)TinyNode, FBXNode);
+					if (ParallelExtraction)
+					{
+						Assistor->PendingMeshes.push_back(TPendingMesh((TMeshNode<Type>*)TinyNode, FBXNode));
+					}
+					else
+					{
+						ExtractMesh((TMeshNode<Type>*)TinyNode, FBXNode);
+					}
 					if (strlen(FBXNode->GetName()) > 0)
 					{
 						strncpy(TinyNode->Name, FBXNode->GetName(), 255 - 1);
 					}
-					Meshes[TinyNode->Name] = (TMeshNode<Type>*)TinyNode;
+					Meshes.Add(TinyNode->Name, (TMeshNode<Type>*)TinyNode);
 					break;
 				}
 
@@ -789,7 +1767,7 @@ struct TScene
 					{
 						strcpy(TinyNode->Name, FBXNode->GetName());
 					}
-					Cameras[TinyNode->Name] = (TCameraNode<Type>*)TinyNode;
+					Cameras.Add(TinyNode->Name, (TCameraNode<Type>*)TinyNode);
 					break;
 				}
 
@@ -802,7 +1780,7 @@ struct TScene
 					{
 						strncpy(TinyNode->Name, FBXNode->GetName(), 254);
 					}
-					Lights[TinyNode->Name] = (TLightNode<Type>*)TinyNode;
+					Lights.Add(TinyNode->Name, (TLightNode<Type>*)TinyNode);
 					break;
 				}
 			}
@@ -826,384 +1804,852 @@ struct TScene
 		FbxVector4 Row2 = Local.GetRow(2);
 		FbxVector4 Row3 = Local.GetRow(3);
 
-		TinyNode->LocalTransform[0] = Row0.mData[0];
-		TinyNode->LocalTransform[1] = Row0.mData[1];
-		TinyNode->LocalTransform[2] = Row0.mData[2];
-		TinyNode->LocalTransform[3] = Row0.mData[3];
+		for (int i = 0; i < 4; i++)
+		{
+			TinyNode->LocalTransform[i] = (Type)Row0.mData[i];
+			TinyNode->LocalTransform[4 + i] = (Type)Row1.mData[i];
+			TinyNode->LocalTransform[8 + i] = (Type)Row2.mData[i];
+			TinyNode->LocalTransform[12 + i] = (Type)Row3.mData[i];
+		}
+
+		MultiplyMatrix(TinyNode->LocalTransform, Parent->GlobalTransform, TinyNode->GlobalTransform);
+		if (TinyNode->NodeType == TNode<Type>::TCAMERA)
+		{
+			ExtractCameraView((TCameraNode<Type>*)TinyNode, FBXNode);
+		}
+
+		if (IsBone)
+		{
+			Assistor->Bones.push_back(TinyNode);
+		}
+
+		for (int Iter = 0; Iter < FBXNode->GetChildCount(); Iter++)
+		{
+			ExtractObject(TinyNode, (void*)FBXNode->GetChild(Iter));
+		}
+	}
+
+	//one attribute layer of a mesh converted to Type. the last element of Data
+	//is the default used by corners the layer does not cover
+	struct TMeshLayer
+	{
+		TMeshLayer() : Mapping(FbxGeometryElement::eNone), Reference(FbxGeometryElement::eDirect){}
+
+		FbxGeometryElement::EMappingMode Mapping;
+		FbxGeometryElement::EReferenceMode Reference;
+		std::vector<Type> Data;
+		std::vector<int> IndexArray;
+
+		//element used by every polygon corner
+		std::vector<int> Elements;
+	};
+
+	void ExtractMesh(TMeshNode<Type>* Mesh, void* Object)
+	{
+		FbxNode* FBXNode = (FbxNode*)Object;
+		FbxMesh* FBXMesh = (FbxMesh*)FBXNode->GetNodeAttribute();
+
+		ExtractMeshGeometry(Mesh, FBXMesh);
+		Mesh->Material = ExtractMaterial(FBXMesh);
+	}
+
+	//extracts the meshes ExtractObject deferred. each unique FbxMesh becomes one
+	//task and the results are merged back in scene walk order, so the output does
+	//not depend on how the tasks were scheduled
+	void ExtractPendingMeshes()
+	{
+		std::vector<TPendingMesh>& Pending = Assistor->PendingMeshes;
+		std::vector<unsigned int> Owners(Pending.size());
+		std::vector<unsigned int> Tasks;
+		std::map<FbxNodeAttribute*, unsigned int> FirstUse;
 
-		for (int RowIter = 0; RowIter < 4; RowIter++)
+		for (unsigned int PendingIter = 0; PendingIter < Pending.size(); PendingIter++)
 		{
-			for (int i = 0; i < 4; i++)
+			FbxNodeAttribute* Attribute = Pending[PendingIter].FBXNode->GetNodeAttribute();
+			auto FirstIter = FirstUse.find(Attribute);
+
+			if (FirstIter == FirstUse.end())
 			{
-				switch (RowIter)
-				{
-				case 0:
-				{
-					TinyNode->LocalTransform[i + (i * RowIter)] = Row0.mData[i];
-					break;
-				}
+				FirstUse[Attribute] = PendingIter;
+				Owners[PendingIter] = PendingIter;
+				Tasks.push_back(PendingIter);
+			}
+			else
+			{
+				Owners[PendingIter] = FirstIter->second;
+			}
+		}
 
-				case 1:
-				{
-					TinyNode->LocalTransform[i + (i * RowIter)] = Row1.mData[i];
-					break;
-				}
+		ParallelFor(Tasks.size(), ThreadCount, [&](unsigned int TaskIter)
+		{
+			const TPendingMesh& Task = Pending[Tasks[TaskIter]];
+			ExtractMeshGeometry(Task.Mesh, (FbxMesh*)Task.FBXNode->GetNodeAttribute());
+		});
 
-				case 2:
-				{
-					TinyNode->LocalTransform[i + (i * RowIter)] = Row2.mData[i];
-					break;
-				}
+		//materials touch the shared material map so they are resolved serially
+		for (unsigned int PendingIter = 0; PendingIter < Pending.size(); PendingIter++)
+		{
+			TMeshNode<Type>* Mesh = Pending[PendingIter].Mesh;
+			if (Owners[PendingIter] != PendingIter)
+			{
+				Mesh->CopyGeometry(*Pending[Owners[PendingIter]].Mesh);
+			}
+			Mesh->Material = ExtractMaterial((FbxMesh*)Pending[PendingIter].FBXNode->GetNodeAttribute());
+		}
+		Pending.clear();
+	}
 
-				case 3:
-				{
-					TinyNode->LocalTransform[i + (i * RowIter)] = Row3.mData[i];
-					break;
-				}
+	//everything about a mesh that only reads from the FBX scene, so it is safe
+	//to run for several meshes at once
+	void ExtractMeshGeometry(TMeshNode<Type>* Mesh, void* Geometry)
+	{
+		FbxMesh* FBXMesh = (FbxMesh*)Geometry;
 
-				default:
+		int PolyIter, J, L;
+		int PolyCount = FBXMesh->GetPolygonCount();
+		int ControlPointCount = FBXMesh->GetControlPointsCount();
+		const int* PolygonVertices = FBXMesh->GetPolygonVertices();
+
+		//count everything up front so the buffers are only allocated once
+		int CornerCount = FBXMesh->GetPolygonVertexCount();
+		unsigned int TriangleCount = 0;
+		int MaxPolySize = 0;
+		std::vector<int> CornerPolygons(CornerCount);
+		int Corner = 0;
+
+		for (PolyIter = 0; PolyIter < PolyCount; PolyIter++)
+		{
+			int PolySize = FBXMesh->GetPolygonSize(PolyIter);
+			if (PolySize > 2)
+			{
+				TriangleCount += PolySize - 2;
+			}
+			MaxPolySize = Max(MaxPolySize, PolySize);
+
+			for (J = 0; J < PolySize; J++)
+			{
+				CornerPolygons[Corner++] = PolyIter;
+			}
+		}
+
+		//welding can only shrink the vertex count so the corner count is the upper bound
+		Mesh->Vertices.clear();
+		Mesh->Vertices.reserve(CornerCount);
+		Mesh->Indices.resize(TriangleCount * 3);
+
+		static_assert(sizeof(FbxVector4) == sizeof(double) * 4, "FbxVector4 is expected to be 4 packed doubles");
+		static_assert(sizeof(FbxVector2) == sizeof(double) * 2, "FbxVector2 is expected to be 2 packed doubles");
+		static_assert(sizeof(FbxColor) == sizeof(double) * 4, "FbxColor is expected to be 4 packed doubles");
+
+		std::vector<Type> Positions(ControlPointCount * 3);
+		if (ControlPointCount > 0)
+		{
+			ConvertDoubles<3>((const double*)FBXMesh->GetControlPoints(), 4, Positions.data(), 3, ControlPointCount);
+		}
+
+		//mapping and reference modes are resolved here once per layer, the
+		//corner loop below just gathers whatever element each corner was given
+		const Type White[4] = { 1, 1, 1, 1 };
+		const Type Zero[4] = { 0, 0, 0, 0 };
+		TMeshLayer Colors, Normals, UVs[2];
+
+		ConvertLayer<FbxColor, 4>(FBXMesh->GetElementVertexColorCount() > 0 ? FBXMesh->GetElementVertexColor(0) : nullptr, Colors, White);
+		ConvertLayer<FbxVector4, 3>(FBXMesh->GetElementNormalCount() > 0 ? FBXMesh->GetElementNormal(0) : nullptr, Normals, Zero);
+
+		for (L = 0; L < 2; L++)
+		{
+			ConvertLayer<FbxVector2, 2>(L < FBXMesh->GetElementUVCount() ? FBXMesh->GetElementUV(L) : nullptr, UVs[L], Zero);
+		}
+
+		DecodeLayer(Colors, 4, PolygonVertices, CornerPolygons.data(), CornerCount);
+		DecodeLayer(Normals, 3, PolygonVertices, CornerPolygons.data(), CornerCount);
+		DecodeLayer(UVs[0], 2, PolygonVertices, CornerPolygons.data(), CornerCount);
+		DecodeLayer(UVs[1], 2, PolygonVertices, CornerPolygons.data(), CornerCount);
+
+		const int* ColorElements = Colors.Elements.data();
+		const int* NormalElements = Normals.Elements.data();
+		const int* UVElements = UVs[0].Elements.data();
+		const int* UV2Elements = UVs[1].Elements.data();
+
+		TVertex<Type> Vertex = TVertex<Type>();
+		Vertex.Position[3] = 1;
+
+		//skin influences are bound by control point after welding, so skinned
+		//meshes keep the control point in the key
+		int ControlPointTag = (FBXMesh->GetDeformerCount(FbxDeformer::eSkin) > 0) ? (int)TVertex<Type>::TControlPointOffset : -1;
+		TVertexWelder<TVertex<Type>, Type> Welder(TVertex<Type>::TControlPointOffset / sizeof(Type), WeldEpsilon, ControlPointTag);
+		Welder.Reserve(CornerCount);
+
+		std::vector<unsigned int> PolyIndices(MaxPolySize);
+		unsigned int* Indices = Mesh->Indices.data();
+		Corner = 0;
+
+		for (PolyIter = 0; PolyIter < PolyCount; PolyIter++)
+		{
+			int PolySize = FBXMesh->GetPolygonSize(PolyIter);
+
+			for (J = 0; J < PolySize; J++, Corner++)
+			{
+				int ControlPointIndex = PolygonVertices[Corner];
+				Vertex.FBXControlPointIndex = ControlPointIndex;
+
+				memcpy(Vertex.Position, &Positions[ControlPointIndex * 3], sizeof(Type) * 3);
+				memcpy(Vertex.Color, &Colors.Data[ColorElements[Corner] * 4], sizeof(Type) * 4);
+				memcpy(Vertex.Normal, &Normals.Data[NormalElements[Corner] * 3], sizeof(Type) * 3);
+				memcpy(Vertex.UV, &UVs[0].Data[UVElements[Corner] * 2], sizeof(Type) * 2);
+				memcpy(Vertex.UV2, &UVs[1].Data[UV2Elements[Corner] * 2], sizeof(Type) * 2);
+
+				PolyIndices[J] = Welder.AddVertGetIndex(Mesh->Vertices, Vertex);
+			}
+
+			//fan out the polygon, quads come out as 0 1 2 and 0 2 3
+			for (J = 2; J < PolySize; J++)
+			{
+				*Indices++ = PolyIndices[0];
+				*Indices++ = PolyIndices[J - 1];
+				*Indices++ = PolyIndices[J];
+			}
+		}
+
+		CalculateTangentsBinormals(Mesh->Vertices, Mesh->Indices);
+		ExtractSkin(Mesh, (void*)FBXMesh);
+		ComputeBounds(Mesh->Vertices, TVertex<Type>::TPositionOffset,
+			Mesh->BoundsMin, Mesh->BoundsMax, Mesh->BoundsCenter, Mesh->BoundsRadius);
+
+		if (LODCount > 0)
+		{
+			GenerateLODs(Mesh);
+		}
+
+		if (OptimizeVertexOrder)
+		{
+			OptimizeMesh(Mesh);
+		}
+
+		if (SplitMeshlets)
+		{
+			GenerateMeshlets(Mesh);
+		}
+
+		if (BuildMeshBVHs)
+		{
+			GenerateBVH(Mesh);
+		}
+
+		if (NarrowIndexBuffers)
+		{
+			NarrowIndices(Mesh);
+		}
+
+		//last, since everything above reads Vertices
+		if (SplitVertexStreams)
+		{
+			SplitStreams(Mesh);
+		}
+	}
+
+	//builds the mesh's triangle BVH over its current Indices. narrowed meshes
+	//and split streams keep theirs, call WidenIndices or JoinStreams first
+	void GenerateBVH(TMeshNode<Type>* Mesh)
+	{
+		if (Mesh->Vertices.empty() || Mesh->Indices.empty())
+		{
+			return;
+		}
+
+		Mesh->BVH.Build(Mesh->Indices, Mesh->Vertices, TVertex<Type>::TPositionOffset, ThreadCount);
+	}
+
+	//moves Indices into 16 bit ShortIndices when the mesh has fewer than 65535
+	//vertices, leaving 0xffff free for primitive restart. larger meshes are cut
+	//into SubMeshes of that many vertices when SplitLargeMeshes is set, which
+	//copies the vertices the ranges share and keeps the triangle order, so
+	//meshlets and the BVH stay valid. does nothing on split streams, call
+	//JoinStreams first
+	void NarrowIndices(TMeshNode<Type>* Mesh)
+	{
+		const unsigned int MaxVertices = 0xffff;
+		unsigned int VertexCount = Mesh->Vertices.size();
+
+		if (VertexCount == 0 || Mesh->Indices.empty())
+		{
+			return;
+		}
+
+		if (VertexCount <= MaxVertices)
+		{
+			TIndexRange Whole = { 0, (unsigned int)Mesh->Indices.size(), 0, VertexCount };
+			Mesh->SubMeshes.assign(1, Whole);
+			Mesh->ShortIndices.assign(Mesh->Indices.begin(), Mesh->Indices.end());
+
+			Mesh->ShortLODIndices.resize(Mesh->LODIndices.size());
+			for (unsigned int LODIter = 0; LODIter < Mesh->LODIndices.size(); LODIter++)
+			{
+				Mesh->ShortLODIndices[LODIter].assign(Mesh->LODIndices[LODIter].begin(), Mesh->LODIndices[LODIter].end());
+			}
+			std::vector<std::vector<unsigned int>>().swap(Mesh->LODIndices);
+		}
+
+		else if (SplitLargeMeshes)
+		{
+			std::vector<unsigned int> VertexMap;
+			SplitIndexRanges(Mesh->Indices, VertexCount, MaxVertices, Mesh->SubMeshes, VertexMap, Mesh->ShortIndices);
+
+			GatherVertexStream(Mesh->Vertices, 1, VertexMap);
+			GatherVertexStream(Mesh->SkinIndices, Mesh->SkinInfluences * Mesh->SkinIndexBytes, VertexMap);
+			GatherVertexStream(Mesh->SkinWeights, Mesh->SkinInfluences * Mesh->SkinWeightBytes, VertexMap);
+
+			//the LODs and meshlets keep whole mesh indices, pointed at the first copy of each vertex
+			std::vector<unsigned int> FirstCopy(VertexCount, 0);
+			for (unsigned int Vertex = VertexMap.size(); Vertex-- > 0;)
+			{
+				FirstCopy[VertexMap[Vertex]] = Vertex;
+			}
+			for (unsigned int LODIter = 0; LODIter < Mesh->LODIndices.size(); LODIter++)
+			{
+				for (unsigned int IndexIter = 0; IndexIter < Mesh->LODIndices[LODIter].size(); IndexIter++)
 				{
-					break;
-				}
-						
+					Mesh->LODIndices[LODIter][IndexIter] = FirstCopy[Mesh->LODIndices[LODIter][IndexIter]];
 				}
 			}
+			for (unsigned int VertexIter = 0; VertexIter < Mesh->MeshletVertices.size(); VertexIter++)
+			{
+				Mesh->MeshletVertices[VertexIter] = FirstCopy[Mesh->MeshletVertices[VertexIter]];
+			}
+		}
+
+		else
+		{
+			return;
+		}
+
+		std::vector<unsigned int>().swap(Mesh->Indices);
+	}
+
+	//moves the mesh into a position only stream and a second stream with the
+	//rest of its varying attributes, quantized when CompressStreams is set.
+	//positions stay full precision for depth and collision passes
+	void SplitStreams(TMeshNode<Type>* Mesh)
+	{
+		std::vector<TVertexLayout<Type>> Layouts(1, TVertexLayout<Type>(TVertexLayout<Type>::TPosition));
+		TVertexLayout<Type> Attributes = Mesh->GetVertexLayout(TVertexLayout<Type>::TAllAttributes & ~TVertexLayout<Type>::TPosition);
+
+		if (CompressStreams)
+		{
+			Attributes.Compress();
+		}
+
+		if (Attributes.Attributes != 0)
+		{
+			Layouts.push_back(Attributes);
+		}
+		Mesh->SplitStreams(Layouts);
+	}
+
+	//recomputes MeshBounds from every mesh's GlobalTransform. Load and
+	//LoadTinyModel call this, call it again after moving nodes
+	void UpdateWorldBounds()
+	{
+		MeshBounds.Resize(Meshes.Size());
+		for (unsigned int MeshIter = 0; MeshIter < Meshes.Size(); MeshIter++)
+		{
+			Type Min[3], Max[3];
+			Meshes.Get(MeshIter)->GetWorldBounds(Min, Max);
+			MeshBounds.Set(MeshIter, Min, Max);
+		}
+	}
+
+	//appends every mesh whose world box reaches into the view projection's
+	//frustum. the matrix uses the row vector layout of GlobalTransform, so a
+	//view times a projection from LookAtMatrix and PerspectiveMatrix
+	void FrustumCull(const Type* ViewProjection, std::vector<TMeshNode<Type>*>& Visible) const
+	{
+		std::vector<unsigned int> Boxes;
+		MeshBounds.Cull(TFrustum<Type>(ViewProjection), Boxes);
+
+		for (unsigned int BoxIter = 0; BoxIter < Boxes.size(); BoxIter++)
+		{
+			Visible.push_back(Meshes.Get(Boxes[BoxIter]));
+		}
+	}
+
+	//as above through a perspective camera's view and projection. AspectRatio
+	//overrides the camera's, which is 0 when the camera follows the window
+	//size. orthographic cameras have no FOV and need the matrix version
+	void FrustumCull(const TCameraNode<Type>* Camera, std::vector<TMeshNode<Type>*>& Visible, Type AspectRatio = 0) const
+	{
+		if (AspectRatio <= 0)
+		{
+			AspectRatio = (Camera->AspectRatio > 0) ? Camera->AspectRatio : 1;
+		}
+
+		Type Projection[16], ViewProjection[16];
+		PerspectiveMatrix(Camera->FOV, AspectRatio, Camera->Near, Camera->Far, Projection);
+		MultiplyMatrix(Camera->ViewMatrix, Projection, ViewProjection);
+		FrustumCull(ViewProjection, Visible);
+	}
+
+	//world box of any node. meshes use their bounds, other nodes are the point at their GlobalTransform
+	static void GetNodeWorldBounds(const TNode<Type>* Node, Type* Min, Type* Max)
+	{
+		if (Node->NodeType == TNode<Type>::TMESH)
+		{
+			((const TMeshNode<Type>*)Node)->GetWorldBounds(Min, Max);
+			return;
+		}
+
+		memcpy(Min, &Node->GlobalTransform[12], sizeof(Type) * 3);
+		memcpy(Max, &Node->GlobalTransform[12], sizeof(Type) * 3);
+	}
+
+	//builds SceneBVH over every node under Root. Load and LoadTinyModel call this
+	void BuildSceneBVH()
+	{
+		SceneBVHNodes.clear();
+		SceneBVHIndices.clear();
+		if (Root != nullptr)
+		{
+			CollectNodes(Root, SceneBVHNodes);
+		}
+
+		std::vector<Type> Boxes(SceneBVHNodes.size() * 6);
+		for (unsigned int NodeIter = 0; NodeIter < SceneBVHNodes.size(); NodeIter++)
+		{
+			GetNodeWorldBounds(SceneBVHNodes[NodeIter], &Boxes[NodeIter * 6], &Boxes[NodeIter * 6 + 3]);
+			SceneBVHIndices[SceneBVHNodes[NodeIter]] = NodeIter;
+		}
+		SceneBVH.Build(Boxes.data(), SceneBVHNodes.size());
+	}
+
+	//refits SceneBVH once the GlobalTransform of Moved has changed. returns
+	//true if the tree had grown loose enough to be rebuilt
+	bool RefitSceneBVH(const std::vector<TNode<Type>*>& Moved)
+	{
+		for (unsigned int NodeIter = 0; NodeIter < Moved.size(); NodeIter++)
+		{
+			auto IndexIter = SceneBVHIndices.find(Moved[NodeIter]);
+			if (IndexIter != SceneBVHIndices.end())
+			{
+				Type Min[3], Max[3];
+				GetNodeWorldBounds(Moved[NodeIter], Min, Max);
+				SceneBVH.Update(IndexIter->second, Min, Max);
+			}
+		}
+		return SceneBVH.Refit();
+	}
+
+	//as above for when most of the scene has moved
+	bool RefitSceneBVH()
+	{
+		return RefitSceneBVH(SceneBVHNodes);
+	}
+
+	//nodes whose world boxes overlap the box Min to Max
+	void QueryRegion(const Type* Min, const Type* Max, std::vector<TNode<Type>*>& Found) const
+	{
+		std::vector<unsigned int> Items;
+		SceneBVH.QueryBox(Min, Max, Items);
+		AppendSceneBVHNodes(Items, Found);
+	}
+
+	//nodes whose world boxes the ray passes through, to be narrowed down with each mesh's BVH
+	void QueryRay(const Type* Origin, const Type* Direction, Type MaxDistance, std::vector<TNode<Type>*>& Found) const
+	{
+		std::vector<unsigned int> Items;
+		SceneBVH.QueryRay(Origin, Direction, MaxDistance, Items);
+		AppendSceneBVHNodes(Items, Found);
+	}
+
+	//nodes whose world boxes reach into the view projection's frustum
+	void QueryFrustum(const Type* ViewProjection, std::vector<TNode<Type>*>& Found) const
+	{
+		std::vector<unsigned int> Items;
+		SceneBVH.QueryFrustum(TFrustum<Type>(ViewProjection), Items);
+		AppendSceneBVHNodes(Items, Found);
+	}
+
+	void AppendSceneBVHNodes(const std::vector<unsigned int>& Items, std::vector<TNode<Type>*>& Found) const
+	{
+		for (unsigned int ItemIter = 0; ItemIter < Items.size(); ItemIter++)
+		{
+			Found.push_back(SceneBVHNodes[Items[ItemIter]]);
+		}
+	}
+
+	//splits Indices into meshlets of up to MeshletMaxVertices vertices and
+	//MeshletMaxTriangles triangles. best run after OptimizeMesh and before
+	//NarrowIndices. narrowed meshes and split streams need WidenIndices or
+	//JoinStreams first
+	void GenerateMeshlets(TMeshNode<Type>* Mesh)
+	{
+		if (Mesh->Vertices.empty() || Mesh->Indices.empty())
+		{
+			return;
+		}
+
+		BuildMeshlets<TVertex<Type>, Type>(Mesh->Indices, Mesh->Vertices, TVertex<Type>::TPositionOffset,
+			MeshletMaxVertices, MeshletMaxTriangles, Mesh->Meshlets, Mesh->MeshletVertices, Mesh->MeshletTriangles);
+	}
+
+	//builds up to LODCount index buffers, each LODReduction the size of the
+	//one before, with SimplifyMesh. stops early once a level cannot be
+	//reduced within LODTargetError. meshes read back with LoadTinyModel
+	//that were saved as split streams or narrowed need JoinStreams or
+	//WidenIndices first
+	void GenerateLODs(TMeshNode<Type>* Mesh)
+	{
+		if (Mesh->Vertices.empty() || Mesh->Indices.empty())
+		{
+			return;
+		}
+
+		Mesh->LODIndices.clear();
+		Mesh->LODErrors.clear();
+
+		Mesh->LODIndices.reserve(LODCount);
+
+		const std::vector<unsigned int>* Source = &Mesh->Indices;
+		Type Error = 0;
+
+		for (unsigned int LODIter = 0; LODIter < LODCount; LODIter++)
+		{
+			unsigned int Target = (unsigned int)(Source->size() / 3 * LODReduction) * 3;
+			std::vector<unsigned int> LOD;
+			Type StepError = (Type)SimplifyMesh<TVertex<Type>, Type>(*Source, Mesh->Vertices, TVertex<Type>::TPositionOffset,
+				Target, (float)(LODTargetError - Error), LOD, ThreadCount);
+
+			if (LOD.empty() || LOD.size() >= Source->size())
+			{
+				break;
+			}
+
+			//simplifying a simplified mesh stacks the errors
+			Error += StepError;
+			Mesh->LODIndices.push_back(std::vector<unsigned int>());
+			Mesh->LODIndices.back().swap(LOD);
+			Mesh->LODErrors.push_back(Error);
+			Source = &Mesh->LODIndices.back();
 		}
+	}
 
-		//TinyNode->GlobalTransform = TinyNode->LocalTransform * Parent->GlobalTransform;
-		if (IsBone)
+	//reorders triangles for the post transform cache, sorts them for overdraw
+	//on static meshes if ReduceOverdraw is set, then renumbers vertices by
+	//first use so fetches run forwards. the skin stream and LODs follow the
+	//vertices. does nothing on split streams or narrowed indices, call
+	//JoinStreams or WidenIndices first
+	void OptimizeMesh(TMeshNode<Type>* Mesh)
+	{
+		if (Mesh->Vertices.empty() || Mesh->Indices.empty())
 		{
-			Assistor->Bones.push_back(TinyNode);
+			return;
 		}
 
-		for (int Iter = 0; Iter < FBXNode->GetChildCount(); Iter++)
+		unsigned int VertexCount = Mesh->Vertices.size();
+		Mesh->CacheStatsBefore = AnalyzeVertexCache(Mesh->Indices, VertexCount, VertexCacheSize);
+
+		OptimizeVertexCache(Mesh->Indices, VertexCount);
+
+		if (ReduceOverdraw && Mesh->SkinInfluences == 0)
 		{
-			ExtractObject(TinyNode, (void*)FBXNode->GetChild(Iter));
+			OptimizeOverdraw<TVertex<Type>, Type>(Mesh->Indices, Mesh->Vertices, TVertex<Type>::TPositionOffset,
+				(float)OverdrawThreshold, VertexCacheSize);
 		}
-	}
 
-	void ExtractMesh(TMeshNode<Type>* Mesh, void* Object)
-	{
-		FbxNode* FBXNode = (FbxNode*)Object;
-		FbxMesh* FBXMesh = (FbxMesh*)FBXNode->GetNodeAttribute();
+		std::vector<unsigned int> Remap;
+		unsigned int NewVertexCount = OptimizeVertexFetchRemap(Mesh->Indices, VertexCount, Remap);
+		RemapVertexStream(Mesh->Vertices, 1, Remap, NewVertexCount);
 
-		int PolyIter, J;
-		unsigned int PolyCount = FBXMesh->GetPolygonCount();
-		FbxVector4* ControlPoints = FBXMesh->GetControlPoints();
+		for (unsigned int LODIter = 0; LODIter < Mesh->LODIndices.size(); LODIter++)
+		{
+			std::vector<unsigned int>& LOD = Mesh->LODIndices[LODIter];
+			for (unsigned int IndexIter = 0; IndexIter < LOD.size(); IndexIter++)
+			{
+				LOD[IndexIter] = Remap[LOD[IndexIter]];
+			}
+			OptimizeVertexCache(LOD, NewVertexCount);
+		}
 
-		TVertex<Type> Vertex;
-		unsigned int VertexIndex[4] = {};
-		unsigned int VertexID = 0;
+		for (unsigned int VertexIter = 0; VertexIter < Mesh->MeshletVertices.size(); VertexIter++)
+		{
+			Mesh->MeshletVertices[VertexIter] = Remap[Mesh->MeshletVertices[VertexIter]];
+		}
 
-		for (PolyIter = 0; PolyIter < PolyCount; PolyIter++)
+		//the BVH names triangles by their place in Indices, which just changed
+		if (!Mesh->BVH.Nodes.empty())
 		{
-			int L;
-			int PolySize = FBXMesh->GetPolygonSize(PolyIter);
+			GenerateBVH(Mesh);
+		}
 
-			for (J = 0; J < PolySize; J++)
-			{
-				unsigned int ControlPointIndex = FBXMesh->GetPolygonVertex(PolyIter, J);
-				Vertex.FBXControlPointIndex = ControlPointIndex;
+		RemapVertexStream(Mesh->SkinIndices, Mesh->SkinInfluences * Mesh->SkinIndexBytes, Remap, NewVertexCount);
+		RemapVertexStream(Mesh->SkinWeights, Mesh->SkinInfluences * Mesh->SkinWeightBytes, Remap, NewVertexCount);
 
-				FbxVector4 Position = ControlPoints[ControlPointIndex];
-				Vertex.Position[0] = (Type)Position[0];
-				Vertex.Position[1] = (Type)Position[1];
-				Vertex.Position[2] = (Type)Position[2];
+		Mesh->CacheStatsAfter = AnalyzeVertexCache(Mesh->Indices, NewVertexCount, VertexCacheSize);
+	}
 
-				for (L = 0; L < FBXMesh->GetElementVertexColorCount(); L++)
-				{
-					FbxGeometryElementVertexColor* GEVC = FBXMesh->GetElementVertexColor(L);
-					switch (GEVC->GetMappingMode())
-					{
-						case FbxGeometryElement::eByControlPoint:
-						{
-							switch (GEVC->GetReferenceMode())
-							{
-								case FbxGeometryElement::eDirect:
-								{
-									FbxColor Color = GEVC->GetDirectArray().GetAt(ControlPointIndex);
-									Vertex.Color[0] = (Type)Color.mRed;
-									Vertex.Color[1] = (Type)Color.mGreen;
-									Vertex.Color[2] = (Type)Color.mBlue;
-									Vertex.Color[3] = (Type)Color.mAlpha;
-									break;
-								}
-						
-								case FbxGeometryElement::eIndexToDirect:
-								{
-									unsigned int ID = GEVC->GetIndexArray().GetAt(ControlPointIndex);
-									FbxColor Color = GEVC->GetDirectArray().GetAt(ID);
-
-									Vertex.Color[0] = (Type)Color.mRed;
-									Vertex.Color[1] = (Type)Color.mGreen;
-									Vertex.Color[2] = (Type)Color.mBlue;
-									Vertex.Color[3] = (Type)Color.mAlpha;
-									break;
-								}
-								default:
-								{
-									break;
-								}
-							}
-							break;
-						}
+	//converts a whole layer element to Type and appends Default as the fallback element
+	template<typename ElementType, unsigned int Components>
+	void ConvertLayer(FbxLayerElementTemplate<ElementType>* Element, TMeshLayer& Layer, const Type* Default)
+	{
+		int DirectCount = 0;
 
-						case FbxGeometryElement::eByPolygonVertex:
-						{
-							switch (GEVC->GetReferenceMode())
-							{
-								case FbxGeometryElement::eDirect:
-								{
-									FbxColor Color = GEVC->GetDirectArray().GetAt(ControlPointIndex);
-									Vertex.Color[0] = (Type)Color.mRed;
-									Vertex.Color[1] = (Type)Color.mGreen;
-									Vertex.Color[2] = (Type)Color.mBlue;
-									Vertex.Color[3] = (Type)Color.mAlpha;
-									break;
-								}
-
-								case FbxGeometryElement::eIndexToDirect:
-								{
-									unsigned int ID = GEVC->GetIndexArray().GetAt(ControlPointIndex);
-									FbxColor Color = GEVC->GetDirectArray().GetAt(ID);
-
-									Vertex.Color[0] = (Type)Color.mRed;
-									Vertex.Color[1] = (Type)Color.mGreen;
-									Vertex.Color[2] = (Type)Color.mBlue;
-									Vertex.Color[3] = (Type)Color.mAlpha;
-									break;
-								}
-								default:
-								{
-									break;
-								}
-							}
-						}
+		if (Element != nullptr)
+		{
+			Layer.Mapping = Element->GetMappingMode();
+			Layer.Reference = Element->GetReferenceMode();
 
-						case FbxGeometryElement::eByPolygon:
-						{
-							break;
-						}
+			FbxLayerElementArrayTemplate<ElementType>& DirectArray = Element->GetDirectArray();
+			DirectCount = DirectArray.GetCount();
+			Layer.Data.resize((DirectCount + 1) * Components);
 
-						case FbxGeometryElement::eAllSame:
-						{
-							break;
-						}
+			if (DirectCount > 0)
+			{
+				FbxLayerElementArrayReadLock<ElementType> Lock(DirectArray);
+				ConvertDoubles<Components>((const double*)Lock.GetData(), sizeof(ElementType) / sizeof(double),
+					Layer.Data.data(), Components, DirectCount);
+			}
 
-						case FbxGeometryElement::eNone:
-						{
-							break;
-						}
-					}
-				}
+			if (Layer.Reference == FbxGeometryElement::eIndexToDirect)
+			{
+				FbxLayerElementArrayTemplate<int>& IndexArray = Element->GetIndexArray();
+				int IndexCount = IndexArray.GetCount();
+				Layer.IndexArray.resize(IndexCount);
 
-				for (L = 0; L < FBXMesh->GetElementUVCount(); L++)
+				if (IndexCount > 0)
 				{
-					FbxGeometryElementUV* UV = FBXMesh->GetElementUV(L);
+					FbxLayerElementArrayReadLock<int> Lock(IndexArray);
+					memcpy(Layer.IndexArray.data(), Lock.GetData(), sizeof(int) * IndexCount);
+				}
+			}
+		}
+		else
+		{
+			Layer.Data.resize(Components);
+		}
 
-					switch (UV->GetMappingMode())
-					{
-					case FbxGeometryElement::eByControlPoint:
-					{
-						switch (UV->GetReferenceMode())
-						{
-							case FbxGeometryElement::eDirect:
-							{
-								FbxVector2 uv = UV->GetDirectArray().GetAt(ControlPointIndex);
-								Vertex.UV[0] = (Type)uv[0];
-								Vertex.UV[1] = (Type)uv[1];
-								break;
-							}
+		memcpy(&Layer.Data[DirectCount * Components], Default, sizeof(Type) * Components);
+	}
 
-							case FbxGeometryElement::eIndexToDirect:
-							{
-								unsigned int ID = UV->GetIndexArray().GetAt(ControlPointIndex);
-								FbxVector2 uv = UV->GetDirectArray().GetAt(ID);
-								Vertex.UV[0] = (Type)uv[0];
-								Vertex.UV[1] = (Type)uv[1];
-								break;
-							}
+	//picks the decoder for the layer's mapping/reference pair once and runs it over every corner
+	void DecodeLayer(TMeshLayer& Layer, unsigned int Components, const int* CornerControlPoints,
+		const int* CornerPolygons, int CornerCount)
+	{
+		typedef FbxGeometryElement Element;
+		typedef void (*TDecodeFunction)(const int*, const int*, int, const int*, int, int, int*);
 
-							default:
-							{
-								break;
-							}
-						}
-						break;
-					}
-					case FbxGeometryElement::eByPolygonVertex:
-					{
-						unsigned int TextureUVIndex = FBXMesh->GetTextureUVIndex(PolyIter, J);
-						switch (UV->GetReferenceMode())
-						{
-							case FbxGeometryElement::eDirect:
-							case FbxGeometryElement::eIndexToDirect:
-							{
-								FbxVector2 uv = UV->GetDirectArray().GetAt(TextureUVIndex);
+		TDecodeFunction Decode = nullptr;
+		bool Indexed = Layer.Reference == Element::eIndexToDirect;
 
-								Vertex.UV[0] = (Type)uv[0];
-								Vertex.UV[1] = (Type)uv[1];
-								break;
-							}
+		switch (Layer.Mapping)
+		{
+			case Element::eByControlPoint:
+			{
+				Decode = Indexed ? &TLayerDecoder<Element::eByControlPoint, Element::eIndexToDirect>::Decode :
+					&TLayerDecoder<Element::eByControlPoint, Element::eDirect>::Decode;
+				break;
+			}
 
-							default:
-							{
-								break;
-							}
-						}
-						break;
-					}
-					case FbxGeometryElement::eByPolygon:
-					case FbxGeometryElement::eAllSame:
-					case FbxGeometryElement::eNone:
-					{
-						break;
-					}
-					}
-				}
-				for (L = 0; L < FBXMesh->GetElementNormalCount(); L++)
-				{
-					FbxGeometryElementNormal* Normal = FBXMesh->GetElementNormal(L);
-					if (Normal->GetMappingMode() == FbxGeometryElement::eByControlPoint)
-					{
-						switch (Normal->GetReferenceMode())
-						{
-							case FbxGeometryElement::eDirect:
-							{
-								FbxVector4 normal = Normal->GetDirectArray().GetAt(ControlPointIndex);
-								Vertex.Normal[0] = (Type)normal[0];
-								Vertex.Normal[1] = (Type)normal[1];
-								Vertex.Normal[2] = (Type)normal[2];
-								break;
-							}
-							case FbxGeometryElement::eIndexToDirect:
-							{
-								unsigned int ID = Normal->GetIndexArray().GetAt(ControlPointIndex);
-								FbxVector4 normal = Normal->GetDirectArray().GetAt(ID);
-								Vertex.Normal[0] = (Type)normal[0];
-								Vertex.Normal[1] = (Type)normal[1];
-								Vertex.Normal[2] = (Type)normal[2];
-								break;
-							}
-							default:
-							{
-								break;
-							}
-						}
-					}
-					else if (Normal->GetMappingMode() == FbxGeometryElement::eByPolygonVertex)
-					{
-						switch (Normal->GetReferenceMode())
-						{
-							case FbxGeometryElement::eDirect:
-							{
-								FbxVector4 normal = Normal->GetDirectArray().GetAt(VertexID);
-							
-								Vertex.Normal[0] = (Type)normal[0];
-								Vertex.Normal[1] = (Type)normal[1];
-								Vertex.Normal[2] = (Type)normal[2];
-								break;
-							}
-							case FbxGeometryElement::eIndexToDirect:
-							{
-								unsigned int ID = Normal->GetIndexArray().GetAt(VertexID);
-								FbxVector4 normal = Normal->GetDirectArray().GetAt(ID);
-								Vertex.Normal[0] = (Type)normal[0];
-								Vertex.Normal[1] = (Type)normal[1];
-								Vertex.Normal[2] = (Type)normal[2];
-								break;
-							}
+			case Element::eByPolygonVertex:
+			{
+				Decode = Indexed ? &TLayerDecoder<Element::eByPolygonVertex, Element::eIndexToDirect>::Decode :
+					&TLayerDecoder<Element::eByPolygonVertex, Element::eDirect>::Decode;
+				break;
+			}
 
-							default:
-							{
-								break;
-							}
-						}
-					}
-				}
+			case Element::eByPolygon:
+			{
+				Decode = Indexed ? &TLayerDecoder<Element::eByPolygon, Element::eIndexToDirect>::Decode :
+					&TLayerDecoder<Element::eByPolygon, Element::eDirect>::Decode;
+				break;
+			}
 
-				Mesh->Vertices.push_back(Vertex);
-				VertexIndex[J] = Mesh->Vertices.size() - 1;
-				VertexID++;
+			case Element::eAllSame:
+			{
+				Decode = Indexed ? &TLayerDecoder<Element::eAllSame, Element::eIndexToDirect>::Decode :
+					&TLayerDecoder<Element::eAllSame, Element::eDirect>::Decode;
+				break;
 			}
-			Mesh->Indices.push_back(VertexIndex[0]);
-			Mesh->Indices.push_back(VertexIndex[1]);
-			Mesh->Indices.push_back(VertexIndex[2]);
 
-			if (PolySize == 4)
+			default:
 			{
-				Mesh->Indices.push_back(VertexIndex[0]);
-				Mesh->Indices.push_back(VertexIndex[2]);
-				Mesh->Indices.push_back(VertexIndex[3]);
+				break;
 			}
 		}
-		CalculateTangentsBinormals(Mesh->Vertices, Mesh->Indices);
-		ExtractSkin(Mesh, (void*)FBXMesh);
 
-		Mesh->Material = ExtractMaterial(FBXMesh);
+		int Fallback = Layer.Data.size() / Components - 1;
+		Layer.Elements.resize(CornerCount);
+
+		if (Decode == nullptr)
+		{
+			std::fill(Layer.Elements.begin(), Layer.Elements.end(), Fallback);
+			return;
+		}
+
+		Decode(CornerControlPoints, CornerPolygons, CornerCount,
+			Layer.IndexArray.data(), Layer.IndexArray.size(), Fallback, Layer.Elements.data());
 	}
 
+	//one bone weight on one control point, as read from a skin cluster
+	struct TSkinInfluence
+	{
+		unsigned int ControlPoint;
+		unsigned int Bone;
+		Type Weight;
+	};
+
 	void ExtractSkin(TMeshNode<Type>* Mesh, void* Node)
 	{
 		FbxGeometry* Geometry = (FbxGeometry*)Node;
-		unsigned int I, J, K;
-		unsigned int ClusterCount;
-		FbxCluster* Cluster;
-		char Name[255];
+		FbxSkin* Skin = (FbxSkin*)Geometry->GetDeformer(0, FbxDeformer::eSkin);
+
+		if (Skin == nullptr)
+		{
+			return;
+		}
 
-		int VertCount = Mesh->Vertices.size();
+		unsigned int ClusterCount = Skin->GetClusterCount();
+		unsigned int ControlPointCount = Geometry->GetControlPointsCount();
+		unsigned int VertCount = Mesh->Vertices.size();
 
-		FbxSkin* Skin = (FbxSkin*)Geometry->GetDeformer(0, FbxDeformer::eSkin);
+		//each cluster owns a slice of one flat influence array so they can be read in parallel
+		std::vector<unsigned int> ClusterOffsets(ClusterCount + 1, 0);
+		for (unsigned int ClusterIter = 0; ClusterIter < ClusterCount; ClusterIter++)
+		{
+			FbxCluster* Cluster = Skin->GetCluster(ClusterIter);
+			unsigned int IndexCount = (Cluster->GetLink() != nullptr) ? Cluster->GetControlPointIndicesCount() : 0;
+			ClusterOffsets[ClusterIter + 1] = ClusterOffsets[ClusterIter] + IndexCount;
+		}
+
+		std::vector<TSkinInfluence> Influences(ClusterOffsets[ClusterCount]);
+
+		ParallelFor(ClusterCount, ThreadCount, [&](unsigned int ClusterIter)
+		{
+			FbxCluster* Cluster = Skin->GetCluster(ClusterIter);
+			if (Cluster->GetLink() == nullptr)
+			{
+				return;
+			}
+
+			unsigned int BoneIndex = Assistor->BoneIndices.Find(Cluster->GetLink()->GetName());
+			if (BoneIndex == TNameIndex::Missing)
+			{
+				BoneIndex = 0;
+			}
+
+			const int* Indices = Cluster->GetControlPointIndices();
+			const double* Weights = Cluster->GetControlPointWeights();
+			TSkinInfluence* Influence = Influences.data() + ClusterOffsets[ClusterIter];
+			unsigned int IndexCount = ClusterOffsets[ClusterIter + 1] - ClusterOffsets[ClusterIter];
 
-		if (Skin != nullptr)
+			for (unsigned int IndexIter = 0; IndexIter < IndexCount; IndexIter++)
+			{
+				//negative indices wrap past ControlPointCount and get dropped by BuildBuckets
+				Influence[IndexIter].ControlPoint = (unsigned int)Indices[IndexIter];
+				Influence[IndexIter].Bone = BoneIndex;
+				Influence[IndexIter].Weight = (Type)Weights[IndexIter];
+			}
+		});
+
+		//control point -> vertices and control point -> influences. influences stay in cluster order
+		std::vector<unsigned int> VertexOffsets, VertexList;
+		std::vector<unsigned int> InfluenceOffsets, InfluenceList;
+
+		BuildBuckets(VertCount, ControlPointCount,
+			[&](unsigned int VertIter) { return (unsigned int)Mesh->Vertices[VertIter].FBXControlPointIndex; },
+			VertexOffsets, VertexList);
+		BuildBuckets(Influences.size(), ControlPointCount,
+			[&](unsigned int InfluenceIter) { return Influences[InfluenceIter].ControlPoint; },
+			InfluenceOffsets, InfluenceList);
+
+		//QuantizeWeights works on at most 32 weights at a time
+		unsigned int MaxKept = std::min(std::max(MaxInfluences, 1u), 32u);
+		unsigned int MaxWeight = (SkinWeightBytes == 2) ? 0xffff : 0xff;
+
+		Mesh->SkinInfluences = MaxKept;
+		//Bones is still filling up when meshes are extracted during the node walk,
+		//BoneCount is the full count CollectBones numbered bones against
+		Mesh->SkinIndexBytes = (Assistor->BoneCount <= 256) ? 1 : 2;
+		Mesh->SkinWeightBytes = (SkinWeightBytes == 2) ? 2 : 1;
+		Mesh->SkinIndices.assign(VertCount * MaxKept * Mesh->SkinIndexBytes, 0);
+		Mesh->SkinWeights.assign(VertCount * MaxKept * Mesh->SkinWeightBytes, 0);
+
+		//a control point only writes to its own vertices so blocks of them never overlap
+		const unsigned int BlockSize = 1024;
+		unsigned int BlockCount = (ControlPointCount + BlockSize - 1) / BlockSize;
+
+		ParallelFor(BlockCount, ThreadCount, [&](unsigned int BlockIter)
 		{
-			ClusterCount = Skin->GetClusterCount();
+			unsigned int First = BlockIter * BlockSize;
+			unsigned int Last = std::min(First + BlockSize, ControlPointCount);
 
-			for (J = 0; J != ClusterCount; J++)
+			std::vector<TInfluence> Selected;
+			std::vector<float> Weights(MaxKept);
+			std::vector<unsigned int> Quantized(MaxKept);
+
+			for (unsigned int ControlPoint = First; ControlPoint < Last; ControlPoint++)
 			{
-				Cluster = Skin->GetCluster(J);
-				if (Cluster->GetLink() == nullptr)
+				if (VertexOffsets[ControlPoint] == VertexOffsets[ControlPoint + 1])
 				{
 					continue;
 				}
-				strncpy(Name, Cluster->GetLink()->GetName(), 255);
-				unsigned int BoneIndex = Assistor->BoneIndexMap[Name];
 
-				unsigned int IndexCount = Cluster->GetControlPointIndicesCount();
-				int* Indices = Cluster->GetControlPointIndices();
-				double* Weights = Cluster->GetControlPointWeights();
+				//every vertex on a control point shares its influences so they are picked once
+				Selected.clear();
+				for (unsigned int InfluenceIter = InfluenceOffsets[ControlPoint]; InfluenceIter < InfluenceOffsets[ControlPoint + 1]; InfluenceIter++)
+				{
+					const TSkinInfluence& Influence = Influences[InfluenceList[InfluenceIter]];
+					TInfluence Candidate = { Influence.Bone, (float)Influence.Weight };
+					Selected.push_back(Candidate);
+				}
+
+				unsigned int Kept = SelectInfluences(Selected.data(), Selected.size(), MaxKept);
 
-				for (K = 0; K < IndexCount; K++)
+				std::fill(Weights.begin(), Weights.end(), 0.0f);
+				std::fill(Quantized.begin(), Quantized.end(), 0);
+				for (unsigned int KeptIter = 0; KeptIter < Kept; KeptIter++)
 				{
-					for (I = 0; I < VertCount; I++)
+					Weights[KeptIter] = Selected[KeptIter].Weight;
+				}
+				QuantizeWeights(Weights.data(), Kept, MaxWeight, Quantized.data());
+
+				for (unsigned int VertIter = VertexOffsets[ControlPoint]; VertIter < VertexOffsets[ControlPoint + 1]; VertIter++)
+				{
+					unsigned int VertIndex = VertexList[VertIter];
+					TVertex<Type>& Vertex = Mesh->Vertices[VertIndex];
+
+					for (unsigned int Slot = 0; Slot < 4; Slot++)
+					{
+						Vertex.Indices[Slot] = (Slot < Kept) ? (Type)Selected[Slot].Bone : 0;
+						Vertex.Weights[Slot] = (Slot < Kept) ? (Type)Selected[Slot].Weight : 0;
+					}
+
+					unsigned char* IndexOut = &Mesh->SkinIndices[VertIndex * MaxKept * Mesh->SkinIndexBytes];
+					unsigned char* WeightOut = &Mesh->SkinWeights[VertIndex * MaxKept * Mesh->SkinWeightBytes];
+
+					for (unsigned int KeptIter = 0; KeptIter < Kept; KeptIter++)
 					{
-						if (Mesh->Vertices[I].FBXControlPointIndex == Indices[K])
+						if (Mesh->SkinIndexBytes == 2)
 						{
-							if (Mesh->Vertices[I].Weights[0] == 0)
-							{
-								Mesh->Vertices[I].Weights[0] = (Type)Weights[K];
-								Mesh->Vertices[I].Indices[0] = (Type)BoneIndex;
-							}
-							else if (Mesh->Vertices[I].Weights[1] == 0)
-							{
-								Mesh->Vertices[I].Weights[1] = (Type)Weights[K];
-								Mesh->Vertices[I].Indices[1] = (Type)BoneIndex;
-							}
-							else if (Mesh->Vertices[I].Weights[2] == 0)
-							{
-								Mesh->Vertices[I].Weights[2] = (Type)Weights[K];
-								Mesh->Vertices[I].Indices[2] = (Type)BoneIndex;
-							}
-							else
-							{
-								Mesh->Vertices[I].Weights[3] = (Type)Weights[K];
-								Mesh->Vertices[I].Indices[3] = (Type)BoneIndex;
-							}
+							unsigned short Bone = (unsigned short)Selected[KeptIter].Bone;
+							memcpy(IndexOut + KeptIter * 2, &Bone, 2);
+						}
+						else
+						{
+							IndexOut[KeptIter] = (unsigned char)Selected[KeptIter].Bone;
+						}
+
+						if (Mesh->SkinWeightBytes == 2)
+						{
+							unsigned short Weight = (unsigned short)Quantized[KeptIter];
+							memcpy(WeightOut + KeptIter * 2, &Weight, 2);
+						}
+						else
+						{
+							WeightOut[KeptIter] = (unsigned char)Quantized[KeptIter];
 						}
 					}
 				}
 			}
-		}
+		});
 	}
 
 	void ExtractLight(TLightNode<Type>* Light, void* Object)
@@ -1267,41 +2713,51 @@ struct TScene
 
 		Camera->Near = (Type)FBXCamera->NearPlane.Get();
 		Camera->Far = (Type)FBXCamera->FarPlane.Get();
+	}
 
-		Type Eye[3], To[3], Up[3];
-
-		
-		for (unsigned int i = 0; i < 3; i++)
+	//world space position of an FBX node in the same space as GlobalTransform
+	void GetFBXNodePosition(void* Object, Type* Position)
+	{
+		FbxVector4 Translation = Assistor->Evaluator->GetNodeGlobalTransform((FbxNode*)Object).GetT();
+		for (unsigned int Column = 0; Column < 3; Column++)
 		{
-			Eye[i] = (Type)FBXCamera->Position.Get()[i];
-
-			if (FBXNode->GetTarget() != nullptr)
-			{
-				To[i] = (Type)FBXNode->GetTarget()->LclTranslation.Get()[i];
-			}
-			else
+			Position[Column] = Root->GlobalTransform[12 + Column];
+			for (unsigned int Row = 0; Row < 3; Row++)
 			{
-				To[i] = (Type)FBXCamera->InterestPosition.Get()[i];
+				Position[Column] += (Type)Translation.mData[Row] * Root->GlobalTransform[Row * 4 + Column];
 			}
+		}
+	}
 
-			if (FBXNode->GetTargetUp())
-			{
-				Up[i] = (Type)FBXNode->GetTargetUp()->LclTranslation.Get()[i];
-			}
+	//the view is built once GlobalTransform is known so it lines up with the world bounds.
+	//FBX cameras look down their local X axis with Y up unless a target node says otherwise
+	void ExtractCameraView(TCameraNode<Type>* Camera, void* Object)
+	{
+		FbxNode* FBXNode = (FbxNode*)Object;
+		Type Eye[3], To[3], Up[3];
 
-			else
-			{
-				Up[i] = (Type)FBXCamera->UpVector.Get()[i];
-			}
+		for (unsigned int Iter = 0; Iter < 3; Iter++)
+		{
+			Eye[Iter] = Camera->GlobalTransform[12 + Iter];
+			To[Iter] = Eye[Iter] + Camera->GlobalTransform[Iter];
+			Up[Iter] = Camera->GlobalTransform[4 + Iter];
 		}
 
-		for (unsigned int i = 0; i < 3; i++)
+		if (FBXNode->GetTarget() != nullptr)
 		{
-			Up[i] = (Up[i] / Up[i]);
+			GetFBXNodePosition(FBXNode->GetTarget(), To);
 		}
-		
-		//create a view matrix
 
+		if (FBXNode->GetTargetUp() != nullptr)
+		{
+			GetFBXNodePosition(FBXNode->GetTargetUp(), Up);
+			for (unsigned int Iter = 0; Iter < 3; Iter++)
+			{
+				Up[Iter] -= Eye[Iter];
+			}
+		}
+
+		LookAtMatrix(Eye, To, Up, Camera->ViewMatrix);
 	}
 
 	TMaterial<Type>* ExtractMaterial(void* Mesh)
@@ -1327,11 +2783,12 @@ struct TScene
 			char MaterialName[255];
 			strncpy(MaterialName, Material->GetName(), 254);
 
-			auto Iter = Materials.find(MaterialName);
+			MaterialName[254] = '\0';
+			TMaterial<Type>* Existing = Materials.Find(MaterialName);
 
-			if (Iter != Materials.end())
+			if (Existing != nullptr)
 			{
-				return Iter->second;
+				return Existing;
 			}
 
 			else
@@ -1455,7 +2912,7 @@ struct TScene
 						}
 					}
 				}
-				Materials[TinyMaterial->Name] = TinyMaterial;
+				Materials.Add(TinyMaterial->Name, TinyMaterial);
 				return TinyMaterial;
 			}
 		}
@@ -1465,6 +2922,19 @@ struct TScene
 	{
 		FbxScene* FBXScene = (FbxScene*)Scene;
 
+		double FrameRate = AnimationFrameRate;
+		if (FrameRate <= 0)
+		{
+			FbxTime::EMode TimeMode = FBXScene->GetGlobalSettings().GetTimeMode();
+			FrameRate = (TimeMode == FbxTime::eCustom) ?
+				FBXScene->GetGlobalSettings().GetCustomFrameRate() : FbxTime::GetFrameRate(TimeMode);
+		}
+
+		if (FrameRate <= 0)
+		{
+			FrameRate = 24.0;
+		}
+
 		for (unsigned int i = 0; i < FBXScene->GetSrcObjectCount<FbxAnimStack>(); i++)
 		{
 			FbxAnimStack* AnimationStack = FBXScene->GetSrcObject<FbxAnimStack>(i);
@@ -1478,196 +2948,128 @@ struct TScene
 			for (unsigned int LayerIter = 0; LayerIter < AnimationLayers; LayerIter++)
 			{
 				FbxAnimLayer* AnimationLayer = AnimationStack->GetMember<FbxAnimLayer>(LayerIter);
-				ExtractAnimationTrack(Tracks, AnimationLayer, FBXScene->GetRootNode());
+				ExtractAnimationTrack(Tracks, AnimationLayer, FBXScene->GetRootNode(), FrameRate);
 			}
 
-			Animation->StartFrame = 999999999;
+			Animation->StartFrame = 0;
 			Animation->EndFrame = 0;
 
 			Animation->TrackCount = Tracks.size();
+			Animation->Tracks = nullptr;
 
 			if (Animation->TrackCount > 0)
 			{
 				Animation->Tracks = new TTrack<Type>[Animation->TrackCount];
 				memcpy(Animation->Tracks, Tracks.data(), sizeof(TTrack<Type>) * Animation->TrackCount);
 
+				//key frames are sorted so only the ends of each track matter
+				Animation->StartFrame = 0xffffffff;
 				for (unsigned int j = 0; j < Animation->TrackCount; j++)
 				{
-					for (unsigned int k = 0; k < Animation->Tracks[j].KeyFrameCount; k++)
-					{
-						Animation->StartFrame = (Animation->StartFrame > Animation->Tracks[j].KeyFrames[k].Key) ? Animation->StartFrame : Animation->Tracks[j].KeyFrames[k].Key;
-						Animation->EndFrame = (Animation->EndFrame < Animation->Tracks[j].KeyFrames[k].Key) ? Animation->EndFrame : Animation->Tracks[j].KeyFrames[k].Key;
-					}
+					const TTrack<Type>& Track = Animation->Tracks[j];
+					Animation->StartFrame = std::min(Animation->StartFrame, Track.KeyFrames[0].Key);
+					Animation->EndFrame = std::max(Animation->EndFrame, Track.KeyFrames[Track.KeyFrameCount - 1].Key);
 				}
 			}
-			Animations[Animation->Name] = Animation;
+			Animations.Add(Animation->Name, Animation);
 		}
 	}
 
-	void ExtractAnimationTrack(std::vector<TTrack<Type>>& Tracks, void* Layer, void* Node)
+	static unsigned int TimeToFrame(FbxLongLong Time, double FrameRate)
+	{
+		double Frame = floor((double)Time * FrameRate / (double)FBXSDK_TC_SECOND + 0.5);
+		return (Frame > 0) ? (unsigned int)Frame : 0;
+	}
+
+	void ExtractAnimationTrack(std::vector<TTrack<Type>>& Tracks, void* Layer, void* Node, double FrameRate)
 	{
 		FbxAnimLayer* AnimLayer = (FbxAnimLayer*)Layer;
 		FbxNode* FBXNode = (FbxNode*)Node;
 
 		TSkeleton<Type>* Skeleton = Skeletons[0];
 
-		int BoneIndex = -1;
+		unsigned int BoneIndex = Assistor->BoneIndices.Find(FBXNode->GetName());
 
-		for (unsigned int i = 0; i < Skeleton->BoneCount; i++)
+		if (BoneIndex < Skeleton->BoneCount)
 		{
-			if (strncmp(Skeleton->Nodes[i]->Name, FBXNode->GetName(), 255) == 0)
-			{
-				BoneIndex = i;
-				break;
-			}
-		}
-		if (BoneIndex >= 0)
-		{
-			FbxAnimCurve* AnimCurve = nullptr;
-			std::map<int, FbxTime> KeyFrameTimes;
-
-			int KeyCount = 0;
-			int Count;
-			char TimeString[256];
-
-			AnimCurve = FBXNode->LclTranslation.GetCurve(AnimLayer, FBXSDK_CURVENODE_COMPONENT_X);
-			if (AnimCurve)
-			{
-				KeyCount = AnimCurve->KeyGetCount();
-				for (Count = 0; Count < KeyCount; Count++)
-				{
-					int Key = atoi(AnimCurve->KeyGetTime(Count).GetTimeString(TimeString, FbxUShort(256)));
-					KeyFrameTimes[Key] = AnimCurve->KeyGetTime(Count);
-				}
-			}
-
-			AnimCurve = FBXNode->LclTranslation.GetCurve(AnimLayer, FBXSDK_CURVENODE_COMPONENT_Y);
-			if (AnimCurve)
-			{
-				KeyCount = AnimCurve->KeyGetCount();
-				for (Count = 0; Count < KeyCount; Count++)
-				{
-					int Key = atoi(AnimCurve->KeyGetTime(Count).GetTimeString(TimeString, FbxUShort(256)));
-					KeyFrameTimes[Key] = AnimCurve->KeyGetTime(Count);
-				}
-			}
-
-			AnimCurve = FBXNode->LclTranslation.GetCurve(AnimLayer, FBXSDK_CURVENODE_COMPONENT_Z);
-			if (AnimCurve)
-			{
-				KeyCount = AnimCurve->KeyGetCount();
-				for (Count = 0; Count < KeyCount; Count++)
-				{
-					int Key = atoi(AnimCurve->KeyGetTime(Count).GetTimeString(TimeString, FbxUShort(256)));
-					KeyFrameTimes[Key] = AnimCurve->KeyGetTime(Count);
-				}
-			}
-
-			AnimCurve = FBXNode->LclRotation.GetCurve(AnimLayer, FBXSDK_CURVENODE_COMPONENT_X);
-			if (AnimCurve)
-			{
-				KeyCount = AnimCurve->KeyGetCount();
-				for (Count = 0; Count < KeyCount; Count++)
-				{
-					int Key = atoi(AnimCurve->KeyGetTime(Count).GetTimeString(TimeString, FbxUShort(256)));
-					KeyFrameTimes[Key] = AnimCurve->KeyGetTime(Count);
-				}
-			}
+			FbxProperty* Properties[3] = { &FBXNode->LclTranslation, &FBXNode->LclRotation, &FBXNode->LclScaling };
+			const char* Channels[3] = { FBXSDK_CURVENODE_COMPONENT_X, FBXSDK_CURVENODE_COMPONENT_Y, FBXSDK_CURVENODE_COMPONENT_Z };
 
-			AnimCurve = FBXNode->LclRotation.GetCurve(AnimLayer, FBXSDK_CURVENODE_COMPONENT_Y);
-			if (AnimCurve)
-			{
-				KeyCount = AnimCurve->KeyGetCount();
-				for (Count = 0; Count < KeyCount; Count++)
-				{
-					int Key = atoi(AnimCurve->KeyGetTime(Count).GetTimeString(TimeString, FbxUShort(256)));
-					KeyFrameTimes[Key] = AnimCurve->KeyGetTime(Count);
-				}
-			}
+			//each curve is already in time order so they are merged in rather than sorted
+			std::vector<FbxLongLong> KeyTimes;
 
-			AnimCurve = FBXNode->LclRotation.GetCurve(AnimLayer, FBXSDK_CURVENODE_COMPONENT_Z);
-			if (AnimCurve)
+			for (unsigned int PropertyIter = 0; PropertyIter < 3; PropertyIter++)
 			{
-				KeyCount = AnimCurve->KeyGetCount();
-				for (Count = 0; Count < KeyCount; Count++)
+				for (unsigned int ChannelIter = 0; ChannelIter < 3; ChannelIter++)
 				{
-					int Key = atoi(AnimCurve->KeyGetTime(Count).GetTimeString(TimeString, FbxUShort(256)));
-					KeyFrameTimes[Key] = AnimCurve->KeyGetTime(Count);
-				}
-			}
+					FbxAnimCurve* AnimCurve = Properties[PropertyIter]->GetCurve(AnimLayer, Channels[ChannelIter]);
+					if (AnimCurve == nullptr)
+					{
+						continue;
+					}
 
-			AnimCurve = FBXNode->LclScaling.GetCurve(AnimLayer, FBXSDK_CURVENODE_COMPONENT_X);
-			if (AnimCurve)
-			{
-				KeyCount = AnimCurve->KeyGetCount();
-				for (Count = 0; Count < KeyCount; Count++)
-				{
-					int Key = atoi(AnimCurve->KeyGetTime(Count).GetTimeString(TimeString, FbxUShort(256)));
-					KeyFrameTimes[Key] = AnimCurve->KeyGetTime(Count);
-				}
-			}
+					unsigned int Middle = KeyTimes.size();
+					int KeyCount = AnimCurve->KeyGetCount();
+					for (int KeyIter = 0; KeyIter < KeyCount; KeyIter++)
+					{
+						KeyTimes.push_back(AnimCurve->KeyGetTime(KeyIter).Get());
+					}
 
-			AnimCurve = FBXNode->LclScaling.GetCurve(AnimLayer, FBXSDK_CURVENODE_COMPONENT_Y);
-			if (AnimCurve)
-			{
-				KeyCount = AnimCurve->KeyGetCount();
-				for (Count = 0; Count < KeyCount; Count++)
-				{
-					int Key = atoi(AnimCurve->KeyGetTime(Count).GetTimeString(TimeString, FbxUShort(256)));
-					KeyFrameTimes[Key] = AnimCurve->KeyGetTime(Count);
+					if (!std::is_sorted(KeyTimes.begin() + Middle, KeyTimes.end()))
+					{
+						std::sort(KeyTimes.begin() + Middle, KeyTimes.end());
+					}
+					std::inplace_merge(KeyTimes.begin(), KeyTimes.begin() + Middle, KeyTimes.end());
 				}
 			}
 
-			AnimCurve = FBXNode->LclScaling.GetCurve(AnimLayer, FBXSDK_CURVENODE_COMPONENT_Z);
-			if (AnimCurve)
+			//keys landing on the same frame collapse onto the first of them
+			std::vector<unsigned int> Frames;
+			std::vector<FbxLongLong> FrameTimes;
+			Frames.reserve(KeyTimes.size());
+			FrameTimes.reserve(KeyTimes.size());
+
+			for (unsigned int KeyIter = 0; KeyIter < KeyTimes.size(); KeyIter++)
 			{
-				KeyCount = AnimCurve->KeyGetCount();
-				for (Count = 0; Count < KeyCount; Count++)
+				unsigned int Frame = TimeToFrame(KeyTimes[KeyIter], FrameRate);
+				if (Frames.empty() || Frames.back() != Frame)
 				{
-					int Key = atoi(AnimCurve->KeyGetTime(Count).GetTimeString(TimeString, FbxUShort(256)));
-					KeyFrameTimes[Key] = AnimCurve->KeyGetTime(Count);
+					Frames.push_back(Frame);
+					FrameTimes.push_back(KeyTimes[KeyIter]);
 				}
 			}
 
-			if (KeyFrameTimes.size() > 0)
+			if (Frames.size() > 0)
 			{
 				TTrack<Type> Track;
 
 				Track.BoneIndex = BoneIndex;
-				Track.KeyFrameCount = KeyFrameTimes.size();
+				Track.KeyFrameCount = Frames.size();
 				Track.KeyFrames = new TKeyFrame<Type>[Track.KeyFrameCount];
 
-				int Index = 0;
-
-#if defined(_MSC_VER)
-				for each(auto Iter in KeyFrameTimes)
-#else
-				for (auto Iter : KeyFrameTimes)
-#endif
+				//the evaluator caches per node so every key of this node is sampled in one run
+				FbxTime Time;
+				for (unsigned int Index = 0; Index < Track.KeyFrameCount; Index++)
 				{
-					Track.KeyFrames[Index].Key = Iter.first;
+					TKeyFrame<Type>& KeyFrame = Track.KeyFrames[Index];
+					KeyFrame.Key = Frames[Index];
 
-					FbxAMatrix LocalMatrix = Assistor->Evaluator->GetNodeLocalTransform(FBXNode, Iter.second);
+					Time.Set(FrameTimes[Index]);
+					const FbxAMatrix& LocalMatrix = Assistor->Evaluator->GetNodeLocalTransform(FBXNode, Time);
 
 					FbxQuaternion Rotation = LocalMatrix.GetQ();
 					FbxVector4 Translation = LocalMatrix.GetT();
 					FbxVector4 Scale = LocalMatrix.GetS();
 
-					for (int i = 0; i < 4; i++)
+					for (int i = 0; i < 3; i++)
 					{
-						if (i < 3)
-						{
-							Track.KeyFrames[Index].Rotation[i] = (Type)Rotation[i];
-							Track.KeyFrames[Index].Translation[i] = (Type)Translation[i];
-							Track.KeyFrames[Index].Scale[i] = (Type)Scale[i];
-						}
-						else
-						{
-							Track.KeyFrames[Index].Rotation[i] = 0;
-							Track.KeyFrames[Index].Scale[i] = 0;
-						}
+						KeyFrame.Rotation[i] = (Type)Rotation[i];
+						KeyFrame.Translation[i] = (Type)Translation[i];
+						KeyFrame.Scale[i] = (Type)Scale[i];
 					}
-					Index++;
+					KeyFrame.Rotation[3] = (Type)Rotation[3];
+					KeyFrame.Translation[3] = 1;
+					KeyFrame.Scale[3] = 1;
 				}
 				Tracks.push_back(Track);
 			}
@@ -1676,7 +3078,84 @@ struct TScene
 
 		for (unsigned int i = 0; i < FBXNode->GetChildCount(); i++)
 		{
-			ExtractAnimationTrack(Tracks, AnimLayer, FBXNode->GetChild(i));
+			ExtractAnimationTrack(Tracks, AnimLayer, FBXNode->GetChild(i), FrameRate);
+		}
+	}
+
+	//runs TTrack::Reduce over every imported track. a rotation error on a bone
+	//moves its descendants by up to the error times the length of the longest
+	//bone chain below it, so each bone's rotation tolerance is tightened until
+	//that stays within TranslationTolerance at the tips
+	void ReduceAnimations()
+	{
+		if (Skeletons.empty())
+		{
+			return;
+		}
+
+		TSkeleton<Type>* Skeleton = Skeletons[0];
+		unsigned int BoneCount = Skeleton->BoneCount;
+
+		std::map<TNode<Type>*, unsigned int> NodeBones;
+		for (unsigned int BoneIter = 0; BoneIter < BoneCount; BoneIter++)
+		{
+			NodeBones[Skeleton->Nodes[BoneIter]] = BoneIter;
+		}
+
+		//bones are collected depth first so walking them backwards sees children before parents
+		std::vector<Type> Extents(BoneCount, 0);
+		for (unsigned int BoneIter = BoneCount; BoneIter-- > 0;)
+		{
+			TNode<Type>* Node = Skeleton->Nodes[BoneIter];
+			auto ParentIter = NodeBones.find(Node->Parent);
+			if (ParentIter == NodeBones.end())
+			{
+				continue;
+			}
+
+			const Type* Offset = &Node->LocalTransform[12];
+			Type Length = sqrt(Offset[0] * Offset[0] + Offset[1] * Offset[1] + Offset[2] * Offset[2]);
+			Extents[ParentIter->second] = std::max(Extents[ParentIter->second], Extents[BoneIter] + Length);
+		}
+
+#if defined(_MSC_VER)
+		for each(auto Iter in Animations)
+#else
+		for (auto Iter : Animations)
+#endif
+		{
+			TAnimation<Type>* Animation = Iter;
+
+			ParallelFor(Animation->TrackCount, ThreadCount, [&](unsigned int TrackIter)
+			{
+				TTrack<Type>& Track = Animation->Tracks[TrackIter];
+				Type Extent = (Track.BoneIndex < BoneCount) ? Extents[Track.BoneIndex] : 0;
+				Type Tolerance = RotationTolerance;
+				if (Extent > 0)
+				{
+					Tolerance = std::min(Tolerance, TranslationTolerance / Extent);
+				}
+				Track.Reduce(Tolerance, TranslationTolerance, ScaleTolerance);
+			});
+		}
+	}
+
+	//packs every track that is not packed already. tracks with gaps too wide
+	//for 16 bit key deltas stay as they are
+	void CompressAnimations()
+	{
+#if defined(_MSC_VER)
+		for each(auto Iter in Animations)
+#else
+		for (auto Iter : Animations)
+#endif
+		{
+			TAnimation<Type>* Animation = Iter;
+
+			ParallelFor(Animation->TrackCount, ThreadCount, [&](unsigned int TrackIter)
+			{
+				Animation->Tracks[TrackIter].Compress();
+			});
 		}
 	}
 
@@ -1699,44 +3178,15 @@ struct TScene
 				FbxMatrix PoseMatrix = Pose->GetMatrix(j);
 				FbxMatrix BindMatrix = PoseMatrix.Inverse();
 
-				for (unsigned int k = 0; k < Skeleton->BoneCount; k++)
+				unsigned int k = Assistor->BoneIndices.Find(Name);
+				if (k < Skeleton->BoneCount)
 				{
-					if (strcmp(Name, Skeleton->Nodes[k]->Name) == 0)
+					for (unsigned int l = 0; l < 4; l++)
 					{
-						FbxVector4 Row0 = BindMatrix.GetRow(0);
-						FbxVector4 Row1 = BindMatrix.GetRow(1);
-						FbxVector4 Row2 = BindMatrix.GetRow(2);
-						FbxVector4 Row3 = BindMatrix.GetRow(3);
-						
-						for (unsigned int l = 0; l < 4; l++)
+						FbxVector4 Row = BindMatrix.GetRow(l);
+						for (unsigned int m = 0; m < 4; m++)
 						{
-							switch (l)
-							{
-							case 0:
-							{
-								Skeleton->BindPoses[l][k] = (Type)Row0.mData[l];
-								break;
-							}
-							case 1:
-							{
-								Skeleton->BindPoses[l][k] = (Type)Row1.mData[l];
-								break;
-							}
-							case 2:
-							{
-								Skeleton->BindPoses[l][k] = (Type)Row2.mData[l];
-								break;
-							}
-							case 3:
-							{
-								Skeleton->BindPoses[l][k] = (Type)Row3.mData[l];
-								break;
-							}
-							default:
-							{
-								break;
-							}
-							}
+							Skeleton->BindPoses[k][l * 4 + m] = (Type)Row.mData[m];
 						}
 					}
 				}
@@ -1759,79 +3209,183 @@ struct TScene
 
 	void CalculateTangentsBinormals(std::vector<TVertex<Type>>& Vertices, const std::vector<unsigned int>& Indices)
 	{
-		/*unsigned int VertexCount = Vertices.size();
-		Type* Tan1 = new Type[VertexCount * 2];
-		Type* Tan2 = Tan1 + VertexCount;
-		memset(Tan1, 0, VertexCount * sizeof(Tan1) * 2);
+		GenerateTangents<TVertex<Type>, Type>(Vertices, Indices,
+			TVertex<Type>::TPositionOffset, TVertex<Type>::TNormalOffset, TVertex<Type>::TUVOffset,
+			TVertex<Type>::TTangentOffset, TVertex<Type>::TBiNormalOffset, ThreadCount);
+	}
+
+	enum TFileInfo
+	{
+		TFileMagic = 0x4c444d54, //"TMDL"
+		TFileVersion = 9,
+		TNoIndex = 0xffffffff
+	};
 
-		unsigned int IndexCount = Indices.size();
-		for (unsigned int a = 0; a < IndexCount; a += 3)
+	template<typename ElementType>
+	static void WriteArray(const std::vector<ElementType>& Array, FILE* File)
+	{
+		unsigned int Count = Array.size();
+		fwrite(&Count, sizeof(unsigned int), 1, File);
+		if (Count > 0)
 		{
-			long I1 = Indices[a];
-			long I2 = Indices[a + 1];
-			long I3 = Indices[a + 2];
+			fwrite(Array.data(), sizeof(ElementType), Count, File);
+		}
+	}
 
-			Type Vertex1[4] = Vertices[I1].Position;
-			Type Vertex2[4] = Vertices[I2].Position;
-			Type Vertex3[4] = Vertices[I3].Position;
+	//runs File past its end so every read after this comes up short and
+	//LoadTinyModel sees feof and fails
+	static void FailRead(FILE* File)
+	{
+		fseek(File, 0, SEEK_END);
+		fgetc(File);
+	}
 
-			Type UV1[2] = Vertices[I1].UV;
-			Type UV2[2] = Vertices[I2].UV;
-			Type UV3[2] = Vertices[I3].UV;
+	//counts read from the file are only trusted when Count records of at
+	//least RecordSize bytes fit in what is left of it, so a cut short or
+	//corrupt file fails here rather than in a huge allocation. the seeks would
+	//clear feof, so a file already read past its end fits nothing
+	static bool FitsInFile(FILE* File, size_t Count, size_t RecordSize)
+	{
+		if (feof(File))
+		{
+			return false;
+		}
 
-			Type X1 = Vertex2[0] - Vertex1[0];
-			Type X2 = Vertex3[0] - Vertex1[0];
-			Type Y1 = Vertex2[1] - Vertex1[1];
-			Type Y2 = Vertex3[1] - Vertex1[1];
-			Type Z1 = Vertex2[2] - Vertex1[2];
-			Type Z2 = Vertex3[2] - Vertex1[2];
+		long Position = ftell(File);
+		fseek(File, 0, SEEK_END);
+		long End = ftell(File);
 
-			Type S1 = UV2[0] - UV1[0];
-			Type S2 = UV3[0] - UV1[0];
-			Type T1 = UV2[1] - UV1[1];
-			Type T2 = UV3[1] - UV1[1];
+		if (Position >= 0 && End >= Position && Count <= (size_t)(End - Position) / std::max(RecordSize, (size_t)1))
+		{
+			fseek(File, Position, SEEK_SET);
+			return true;
+		}
 
-			float R = 1.0f / (S2 * T2 - S2 * T1);
+		fgetc(File);
+		return false;
+	}
 
-			Type SDir[4] =
-			{
-				(T2 * X1 - T1 * X2) * R,
-				(T2 * Y1 - T1 * Y2) * R,
-				(T2 * Z1 - T1 * Z2) * R,
-				0
-			};
+	template<typename ElementType>
+	static void ReadArray(std::vector<ElementType>& Array, FILE* File)
+	{
+		unsigned int Count = 0;
+		fread(&Count, sizeof(unsigned int), 1, File);
+		if (!FitsInFile(File, Count, sizeof(ElementType)))
+		{
+			Count = 0;
+		}
 
-			Type TDir[4] =
-			{
-				(S1 * X2 - S2 * X1) * R,
-				(S1 * Y2 - S2 * Y1) * R,
-				(S1 * Z2 - S2 * Z1) * R,
-				0
-			};
+		Array.resize(Count);
+		if (Count > 0)
+		{
+			Array.resize(fread(Array.data(), sizeof(ElementType), Count, File));
+		}
+	}
 
-			Tan1[I1] += SDir;
-			Tan1[I2] += SDir;
-			Tan1[I3] += SDir;
+	//index arrays are stored raw or through EncodeIndexBuffer as
+	//CompressIndices says, with a flag so each one reads back either way
+	template<typename IndexType>
+	void WriteIndices(const std::vector<IndexType>& Indices, FILE* File)
+	{
+		unsigned int Header[2] = { (unsigned int)Indices.size(), (CompressIndices && Indices.size() % 3 == 0) ? 1u : 0u };
+		fwrite(Header, sizeof(unsigned int), 2, File);
 
-			Tan2[I1] += TDir;
-			Tan2[I2] += TDir;
-			Tan2[I3] += TDir;
+		if (Header[1] != 0)
+		{
+			std::vector<unsigned char> Encoded;
+			EncodeIndexBuffer(Indices.data(), Header[0], Encoded);
+			WriteArray(Encoded, File);
 		}
+		else if (Header[0] > 0)
+		{
+			fwrite(Indices.data(), sizeof(IndexType), Header[0], File);
+		}
+	}
+
+	template<typename IndexType>
+	static void ReadIndices(std::vector<IndexType>& Indices, FILE* File)
+	{
+		unsigned int Header[2] = { 0, 0 };
+		fread(Header, sizeof(unsigned int), 2, File);
+		Indices.clear();
+
+		if (Header[1] != 0)
+		{
+			//the codec spends at least a byte on every triangle
+			std::vector<unsigned char> Encoded;
+			ReadArray(Encoded, File);
+			if (Header[0] / 3 >= Encoded.size())
+			{
+				FailRead(File);
+				return;
+			}
 
-	/ *	for (unsigned int a = 0; a < VertexCount; a++)
+			Indices.resize(Header[0]);
+			if (!DecodeIndexBuffer(Encoded.data(), Encoded.size(), Indices.data(), Header[0]))
+			{
+				Indices.clear();
+				FailRead(File);
+			}
+		}
+		else if (Header[0] > 0 && FitsInFile(File, Header[0], sizeof(IndexType)))
 		{
-			const Type Normal[4] = Vertices[a].Normal;
-			const Type Tangent[4] = Tan1[a];
+			Indices.resize(Header[0]);
+			Indices.resize(fread(Indices.data(), sizeof(IndexType), Header[0], File));
+		}
+	}
+
+	//vertex data is stored raw or through EncodeVertexBuffer as
+	//CompressVertices says, Stride bytes to a vertex
+	template<typename ElementType>
+	void WriteVertices(const std::vector<ElementType>& Vertices, unsigned int Stride, FILE* File)
+	{
+		unsigned int Bytes = Vertices.size() * sizeof(ElementType);
+		unsigned int Header[3] = { (unsigned int)Vertices.size(), Stride, (CompressVertices && Stride > 0 && Bytes % Stride == 0) ? 1u : 0u };
+		fwrite(Header, sizeof(unsigned int), 3, File);
 
-			Vertices[a].Tangent = (Tangent - Normal * DotProduct(Normal, Tangent));
-			Vertices[a].Tangent->normalize;
+		if (Header[2] != 0)
+		{
+			std::vector<unsigned char> Encoded;
+			EncodeVertexBuffer((const unsigned char*)Vertices.data(), Bytes / Stride, Stride, Encoded);
+			WriteArray(Encoded, File);
+		}
+		else if (Header[0] > 0)
+		{
+			fwrite(Vertices.data(), sizeof(ElementType), Header[0], File);
+		}
+	}
 
-			Vertices[a].Tangent[3] = (DotProduct(CrossProduct(Normal, Tangent, Tan2[a])) < 0.0f) ? -1.0f : 1.0f;
+	template<typename ElementType>
+	static void ReadVertices(std::vector<ElementType>& Vertices, FILE* File)
+	{
+		unsigned int Header[3] = { 0, 0, 0 };
+		fread(Header, sizeof(unsigned int), 3, File);
+		Vertices.clear();
 
-			Vertices[a].BiNormal[0]
-		}* /
+		if (Header[2] != 0)
+		{
+			//every 64 bytes of a byte plane cost at least one header byte
+			std::vector<unsigned char> Encoded;
+			ReadArray(Encoded, File);
+			size_t Bytes = (size_t)Header[0] * sizeof(ElementType);
+			if (Header[1] == 0 || Bytes % Header[1] != 0 || Bytes / 64 > Encoded.size())
+			{
+				FailRead(File);
+				return;
+			}
 
-		delete[] Tan1;*/
+			Vertices.resize(Header[0]);
+			if (!DecodeVertexBuffer(Encoded.data(), Encoded.size(), (unsigned char*)Vertices.data(), Bytes / Header[1], Header[1]))
+			{
+				Vertices.clear();
+				FailRead(File);
+			}
+		}
+		else if (Header[0] > 0 && FitsInFile(File, Header[0], sizeof(ElementType)))
+		{
+			Vertices.resize(Header[0]);
+			Vertices.resize(fread(Vertices.data(), sizeof(ElementType), Header[0], File));
+		}
 	}
 
 	unsigned int NodeCount(TNode<Type>* Node)
@@ -1844,16 +3398,39 @@ struct TScene
 		return NumNodes;
 	}
 
+	//parents always come before their children so a node only needs its parent's position
+	void CollectNodes(TNode<Type>* Node, std::vector<TNode<Type>*>& Nodes)
+	{
+		Nodes.push_back(Node);
+		for (unsigned int NodeIter = 0; NodeIter < Node->Children.size(); NodeIter++)
+		{
+			CollectNodes(Node->Children[NodeIter], Nodes);
+		}
+	}
+
 	bool SaveTinyModel(const char* FileName)
 	{
+		if (Root == nullptr)
+		{
+			return false;
+		}
+
 		FILE* File = fopen(FileName, "wb");
+		if (File == nullptr)
+		{
+			printf("unable to create %s\n", FileName);
+			return false;
+		}
 
-		unsigned int I, J = 0;
-		unsigned int Address = 0;
+		unsigned int Header[3] = { TFileMagic, TFileVersion, sizeof(Type) };
+		fwrite(Header, sizeof(unsigned int), 3, File);
 
-		fwrite(&AmbientLight, sizeof(Type), 4, File);
+		fwrite(AmbientLight, sizeof(Type), 4, File);
 
-		fwrite(&Materials.size(), sizeof(unsigned int), 1, File);
+		//materials and nodes refer to each other by their position in the file
+		std::map<const TMaterial<Type>*, unsigned int> MaterialIndices;
+		unsigned int ObjectCount = Materials.Size();
+		fwrite(&ObjectCount, sizeof(unsigned int), 1, File);
 
 #if defined(_MSC_VER)
 		for each(auto MaterialIter in Materials)
@@ -1861,28 +3438,46 @@ struct TScene
 		for (auto MaterialIter : Materials)
 #endif
 		{
-			Address = (unsigned int)MaterialIter->second;
+			unsigned int Index = MaterialIndices.size();
+			MaterialIndices[MaterialIter] = Index;
+			fwrite(MaterialIter, sizeof(TMaterial<Type>), 1, File);
+		}
 
-			fwrite(&Address, sizeof(unsigned int), 1, File);
+		std::vector<TNode<Type>*> Nodes;
+		Nodes.reserve(NodeCount(Root));
+		CollectNodes(Root, Nodes);
 
-			fwrite(&MaterialIter->second, sizeof(TMaterial<Type>), 1, File);
+		std::map<const TNode<Type>*, unsigned int> NodeIndices;
+		for (unsigned int NodeIter = 0; NodeIter < Nodes.size(); NodeIter++)
+		{
+			NodeIndices[Nodes[NodeIter]] = NodeIter;
 		}
 
-		unsigned int ObjectCount = NodeCount(Root);
+		ObjectCount = Nodes.size();
 		fwrite(&ObjectCount, sizeof(unsigned int), 1, File);
-		SaveNodeData(Root, File);
+		for (unsigned int NodeIter = 0; NodeIter < Nodes.size(); NodeIter++)
+		{
+			SaveNodeData(Nodes[NodeIter], NodeIndices, MaterialIndices, File);
+		}
 
 		ObjectCount = Skeletons.size();
 		fwrite(&ObjectCount, sizeof(unsigned int), 1, File);
 
 		for (unsigned int SkeletonIter = 0; SkeletonIter < Skeletons.size(); SkeletonIter++)
 		{
-			fwrite(&Skeletons[SkeletonIter]->BoneCount, sizeof(unsigned int), 1, File);
-			fwrite(&Skeletons[SkeletonIter]->BindPoses, sizeof(Type) * 16, Skeletons[SkeletonIter].BoneCount, File);
-			fwrite(&Skeletons[SkeletonIter]->Nodes, sizeof(TNode<Type>*), Skeletons[SkeletonIter].BoneCount, File);
+			const TSkeleton<Type>* Skeleton = Skeletons[SkeletonIter];
+			fwrite(&Skeleton->BoneCount, sizeof(unsigned int), 1, File);
+			fwrite(Skeleton->BindPoses, sizeof(Type) * 16, Skeleton->BoneCount, File);
+
+			for (unsigned int BoneIter = 0; BoneIter < Skeleton->BoneCount; BoneIter++)
+			{
+				auto NodeIter = NodeIndices.find(Skeleton->Nodes[BoneIter]);
+				unsigned int Index = (NodeIter != NodeIndices.end()) ? NodeIter->second : (unsigned int)TNoIndex;
+				fwrite(&Index, sizeof(unsigned int), 1, File);
+			}
 		}
 
-		ObjectCount = Animations.size();
+		ObjectCount = Animations.Size();
 		fwrite(&ObjectCount, sizeof(unsigned int), 1, File);
 
 #if defined(_MSC_VER)
@@ -1891,16 +3486,14 @@ struct TScene
 		for (auto Iter : Animations)
 #endif
 		{
-			fwrite(Iter->second->Name, sizeof(char), 255, File);
-			fwrite(&Iter->second->StartFrame, sizeof(unsigned int), 255, File);
-			fwrite(&Iter->second->EndFrame, sizeof(unsigned int), 255, File);
-			fwrite(&Iter->second->TrackCount, sizeof(unsigned int), 255, File);
+			fwrite(Iter->Name, sizeof(char), 255, File);
+			fwrite(&Iter->StartFrame, sizeof(unsigned int), 1, File);
+			fwrite(&Iter->EndFrame, sizeof(unsigned int), 1, File);
+			fwrite(&Iter->TrackCount, sizeof(unsigned int), 1, File);
 
-			for (unsigned int TrackIter = 0; TrackIter < Iter->second->TrackCount; TrackIter++)
+			for (unsigned int TrackIter = 0; TrackIter < Iter->TrackCount; TrackIter++)
 			{
-				fwrite(&Iter->second->Tracks[TrackIter].BoneIndex, sizeof(unsigned int), 1, File);
-				fwrite(&Iter->second->Tracks[TrackIter].KeyFrameCount, sizeof(unsigned int), 1, File);
-				fwrite(Iter->second->Tracks[TrackIter].KeyFrames, sizeof(TKeyFrame<Type>), Iter->second->Tracks[TrackIter].KeyFrameCount, File);
+				SaveTrackData(Iter->Tracks[TrackIter], File);
 			}
 		}
 
@@ -1908,26 +3501,25 @@ struct TScene
 		return true;
 	}
 
-	void SaveNodeData(TNode<Type>* Node, FILE* File)
+	void SaveNodeData(TNode<Type>* Node, const std::map<const TNode<Type>*, unsigned int>& NodeIndices,
+		const std::map<const TMaterial<Type>*, unsigned int>& MaterialIndices, FILE* File)
 	{
-		unsigned int Address = (unsigned int)Node;
-		fwrite(&Address, sizeof(unsigned int), 1, File);
-
 		fwrite(&Node->NodeType, sizeof(unsigned int), 1, File);
 
-		fwrite(&Node->Name, sizeof(char), 255, File);
+		fwrite(Node->Name, sizeof(char), 255, File);
 
-		Address = (unsigned int)Node->Parent;
-		fwrite(&Address, sizeof(unsigned int), 1, File);
+		auto ParentIter = NodeIndices.find(Node->Parent);
+		unsigned int Parent = (ParentIter != NodeIndices.end()) ? ParentIter->second : (unsigned int)TNoIndex;
+		fwrite(&Parent, sizeof(unsigned int), 1, File);
 
-		fwrite(&Node->LocalTransform, sizeof(Type), 16, File);
-		fwrite(&Node->GlobalTransform, sizeof(Type), 16, File);
+		fwrite(Node->LocalTransform, sizeof(Type), 16, File);
+		fwrite(Node->GlobalTransform, sizeof(Type), 16, File);
 
 		switch (Node->NodeType)
 		{
 		case TNode<Type>::TMESH:
 		{
-			SaveMeshData((TMeshNode<Type>*)Node, File);
+			SaveMeshData((TMeshNode<Type>*)Node, MaterialIndices, File);
 			break;
 		}
 
@@ -1939,7 +3531,7 @@ struct TScene
 
 		case TNode<Type>::TCAMERA:
 		{
-			SaveCameraData((TLightNode<Type>*)Node, File);
+			SaveCameraData((TCameraNode<Type>*)Node, File);
 			break;
 		}
 
@@ -1948,36 +3540,57 @@ struct TScene
 			break;
 		}
 		}
+	}
 
-		unsigned int ChildCount = Node->Children.size();
-		fwrite(&ChildCount, sizeof(unsigned int), 1, File);
-
-		for (unsigned int ChildIter = 0; ChildIter < ChildCount; ChildIter++)
-		{
-			Address = (unsigned int)Node->Children[ChildIter];
-			fwrite(&Address, sizeof(unsigned int), 1, File);
-		}
-
-		for (unsigned int NodeIter = 0; NodeIter < Node->Children.size(); NodeIter++)
+	void SaveMeshData(TMeshNode<Type>* Mesh, const std::map<const TMaterial<Type>*, unsigned int>& MaterialIndices, FILE* File)
+	{
+		auto MaterialIter = MaterialIndices.find(Mesh->Material);
+		unsigned int Material = (MaterialIter != MaterialIndices.end()) ? MaterialIter->second : (unsigned int)TNoIndex;
+		fwrite(&Material, sizeof(unsigned int), 1, File);
+
+		WriteVertices(Mesh->Vertices, sizeof(TVertex<Type>), File);
+		WriteIndices(Mesh->Indices, File);
+
+		unsigned int Skin[3] = { Mesh->SkinInfluences, Mesh->SkinIndexBytes, Mesh->SkinWeightBytes };
+		fwrite(Skin, sizeof(unsigned int), 3, File);
+		WriteArray(Mesh->SkinIndices, File);
+		WriteArray(Mesh->SkinWeights, File);
+
+		//narrowed LODs are written empty here and in full with ShortLODIndices
+		const std::vector<unsigned int> Narrowed;
+		WriteArray(Mesh->LODErrors, File);
+		for (unsigned int LODIter = 0; LODIter < Mesh->LODErrors.size(); LODIter++)
 		{
-			SaveNodeData(Node->Children[NodeIter], File);
+			WriteIndices(LODIter < Mesh->LODIndices.size() ? Mesh->LODIndices[LODIter] : Narrowed, File);
 		}
-	}
 
-	void SaveMeshData(TMeshNode<Type>* Mesh, FILE* File)
-	{
-		unsigned int Address = (unsigned int)Mesh->Material;
-		fwrite(&Address, sizeof(unsigned int), 1, File);
+		fwrite(Mesh->BoundsMin, sizeof(Type), 3, File);
+		fwrite(Mesh->BoundsMax, sizeof(Type), 3, File);
+		fwrite(Mesh->BoundsCenter, sizeof(Type), 3, File);
+		fwrite(&Mesh->BoundsRadius, sizeof(Type), 1, File);
 
-		unsigned int VertexCount = Mesh->Vertices.size();
-		fwrite(VertexCount, sizeof(unsigned int), 1, File);
+		WriteArray(Mesh->Meshlets, File);
+		WriteArray(Mesh->MeshletVertices, File);
+		WriteArray(Mesh->MeshletTriangles, File);
 
-		fwrite(Mesh->Vertices.data(), sizeof(TVertex<Type>), VertexCount, File);
+		WriteArray(Mesh->BVH.Nodes, File);
+		WriteArray(Mesh->BVH.Triangles, File);
+		WriteArray(Mesh->BVH.Positions, File);
 
-		unsigned int IndexCount = Mesh->Indices.size();
-		fwrite(IndexCount, sizeof(unsigned int), 1, File);
+		WriteArray(Mesh->StreamLayouts, File);
+		for (unsigned int StreamIter = 0; StreamIter < Mesh->Streams.size(); StreamIter++)
+		{
+			WriteVertices(Mesh->Streams[StreamIter], Mesh->StreamLayouts[StreamIter].Stride, File);
+		}
 
-		fwrite(Mesh->Indices.data(), sizeof(unsigned int), IndexCount, File);
+		WriteIndices(Mesh->ShortIndices, File);
+		WriteArray(Mesh->SubMeshes, File);
+		unsigned int ShortLODCount = Mesh->ShortLODIndices.size();
+		fwrite(&ShortLODCount, sizeof(unsigned int), 1, File);
+		for (unsigned int LODIter = 0; LODIter < ShortLODCount; LODIter++)
+		{
+			WriteIndices(Mesh->ShortLODIndices[LODIter], File);
+		}
 	}
 
 	void SaveLightData(TLightNode<Type>* Light, FILE* File)
@@ -2006,64 +3619,127 @@ struct TScene
 		fwrite(&Camera->ViewMatrix, sizeof(Type), 16, File);
 	}
 
+	void SaveTrackData(const TTrack<Type>& Track, FILE* File)
+	{
+		unsigned int Info[3] = { Track.BoneIndex, Track.KeyFrameCount, (Track.Compressed != nullptr) ? 1u : 0u };
+		fwrite(Info, sizeof(unsigned int), 3, File);
+
+		if (Track.Compressed == nullptr)
+		{
+			fwrite(Track.KeyFrames, sizeof(TKeyFrame<Type>), Track.KeyFrameCount, File);
+			return;
+		}
+
+		const TCompressedTrack<Type>* Packed = Track.Compressed;
+		fwrite(Packed->TranslationMin, sizeof(Type), 3, File);
+		fwrite(Packed->TranslationRange, sizeof(Type), 3, File);
+		fwrite(Packed->ScaleMin, sizeof(Type), 3, File);
+		fwrite(Packed->ScaleRange, sizeof(Type), 3, File);
+
+		WriteArray(Packed->BlockKeys, File);
+		WriteArray(Packed->KeyDeltas, File);
+		WriteArray(Packed->Rotations, File);
+		WriteArray(Packed->Translations, File);
+		WriteArray(Packed->Scales, File);
+	}
+
 	bool LoadTinyModel(const char* FileName)
 	{
+		if (Root != nullptr)
+		{
+			printf("Scene already loaded!\n");
+			return false;
+		}
+
 		FILE* File = fopen(FileName, "rb");
+		if (File == nullptr)
+		{
+			printf("unable to open %s\n", FileName);
+			return false;
+		}
+
+		unsigned int Header[3] = { 0, 0, 0 };
+		if (fread(Header, sizeof(unsigned int), 3, File) != 3 ||
+			Header[0] != TFileMagic || Header[1] != TFileVersion || Header[2] != sizeof(Type))
+		{
+			printf("%s is not a tiny model this build can read\n", FileName);
+			fclose(File);
+			return false;
+		}
 
 		unsigned int I, J = 0;
-		unsigned int Address = 0;
-		unsigned int NodeType = TNode<Type>::TNODE;
 
-		fread(&AmbientLight, sizeof(Type), 4, File);
+		fread(AmbientLight, sizeof(Type), 4, File);
 
-		unsigned int MaterialCount, NodeCount, SkeletonCount, AnimationCount = 0;
+		unsigned int MaterialCount = 0, NodeCount = 0, SkeletonCount = 0, AnimationCount = 0;
 		fread(&MaterialCount, sizeof(unsigned int), 1, File);
+		if (!FitsInFile(File, MaterialCount, sizeof(TMaterial<Type>)))
+		{
+			MaterialCount = 0;
+		}
 
-		std::map<unsigned int, TMaterial<Type>*> MaterialMap;
-		std::map<unsigned int, TNode<Type>*> NodeMap;
+		std::vector<TMaterial<Type>*> MaterialList;
+		std::vector<TNode<Type>*> NodeList;
 
 		for (I = 0; I < MaterialCount; I++)
 		{
 			TMaterial<Type>* Material = new TMaterial<Type>();
+			fread(Material, sizeof(TMaterial<Type>), 1, File);
 
-			fread(&Address, sizeof(unsigned int), 1, File);
-
-			fread(&Material, sizeof(TMaterial<Type>), 1, File);
-
-			MaterialMap[Address] = Material;
-			Materials[Material->Name] = Material;
+			MaterialList.push_back(Material);
+			Materials.Add(Material->Name, Material);
 		}
 
+		//a node is at least its type, name, parent and transforms
 		fread(&NodeCount, sizeof(unsigned int), 1, File);
-		if (NodeCount > 0)
+		if (!FitsInFile(File, NodeCount, sizeof(unsigned int) * 2 + 255 + sizeof(Type) * 32))
+		{
+			NodeCount = 0;
+		}
+
+		for (I = 0; I < NodeCount; I++)
 		{
-			LoadNode(NodeMap, MaterialMap, File);
-			ReLink(Root, NodeMap);
+			NodeList.push_back(LoadNode(NodeList, MaterialList, File));
 		}
 
 		fread(&SkeletonCount, sizeof(unsigned int), 1, File);
+		if (!FitsInFile(File, SkeletonCount, sizeof(unsigned int)))
+		{
+			SkeletonCount = 0;
+		}
+
 		for (I = 0; I < SkeletonCount; I++)
 		{
 			TSkeleton<Type>* Skeleton = new TSkeleton<Type>();
 
 			fread(&Skeleton->BoneCount, sizeof(unsigned int), 1, File);
+			if (!FitsInFile(File, Skeleton->BoneCount, sizeof(Type) * 16 + sizeof(unsigned int)))
+			{
+				Skeleton->BoneCount = 0;
+			}
 
 			Skeleton->BindPoses = new Type[Skeleton->BoneCount][16];
 			Skeleton->Bones = new Type[Skeleton->BoneCount][16];
-			Skeleton->Nodes = new TNode<Type> *[Skeleton->BoneCount];
+			Skeleton->Nodes = new TNode<Type>*[Skeleton->BoneCount];
 
 			fread(Skeleton->BindPoses, sizeof(Type) * 16, Skeleton->BoneCount, File);
-			fread(Skeleton->Nodes, sizeof(TNode<Type>*), Skeleton->BoneCount, File);
 
 			for (J = 0; J < Skeleton->BoneCount; J++)
 			{
-				Skeleton->Nodes[J] = NodeMap[(unsigned int)Skeleton->Nodes[J]];
+				unsigned int Index = TNoIndex;
+				fread(&Index, sizeof(unsigned int), 1, File);
+				Skeleton->Nodes[J] = (Index < NodeList.size()) ? NodeList[Index] : Root;
+				memcpy(Skeleton->Bones[J], Skeleton->Nodes[J]->LocalTransform, sizeof(Type) * 16);
 			}
 
 			Skeletons.push_back(Skeleton);
 		}
 
-		fread(AnimationCount, sizeof(unsigned int), 1, File);
+		fread(&AnimationCount, sizeof(unsigned int), 1, File);
+		if (!FitsInFile(File, AnimationCount, 255 + sizeof(unsigned int) * 3))
+		{
+			AnimationCount = 0;
+		}
 
 		for (I = 0; I < AnimationCount; I++)
 		{
@@ -2073,41 +3749,54 @@ struct TScene
 			fread(&Animation->StartFrame, sizeof(unsigned int), 1, File);
 			fread(&Animation->EndFrame, sizeof(unsigned int), 1, File);
 			fread(&Animation->TrackCount, sizeof(unsigned int), 1, File);
+			if (!FitsInFile(File, Animation->TrackCount, sizeof(unsigned int) * 3))
+			{
+				Animation->TrackCount = 0;
+			}
 
 			Animation->Tracks = new TTrack<Type>[Animation->TrackCount];
 
 			for (J = 0; J < Animation->TrackCount; J++)
 			{
-				fread(&Animation->Tracks[J].BoneIndex, sizeof(unsigned int), 1, File);
-				fread(&Animation->Tracks[J].KeyFrameCount, sizeof(unsigned int), 1, File);
-
-				Animation->Tracks[J].KeyFrames = new TKeyFrame<Type>[Animation->Tracks[J].KeyFrameCount];
-				fread(Animation->Tracks[J].KeyFrames, sizeof(TKeyFrame<Type>), Animation->Tracks[J].KeyFrameCount, File);
+				LoadTrackData(Animation->Tracks[J], File);
 			}
 
-			Animations[Animation->Name] = Animation;
+			Animations.Add(Animation->Name, Animation);
 		}
+
+		//any read that came up short, or count that did not fit, left File at its end
+		bool Complete = !feof(File) && !ferror(File);
 		fclose(File);
+
+		if (!Complete)
+		{
+			printf("%s is cut short or corrupt\n", FileName);
+			Unload();
+			return false;
+		}
+
+		UpdateWorldBounds();
+		BuildSceneBVH();
+		Path = (char*)FileName;
 		return true;
 	}
 
-	void LoadNode(std::map<unsigned int, TNode<Type>*>& Nodes,
-		std::map<unsigned int, TMaterial<Type>*>& MaterialMap, FILE* File)
+	TNode<Type>* LoadNode(const std::vector<TNode<Type>*>& Nodes,
+		const std::vector<TMaterial<Type>*>& MaterialList, FILE* File)
 	{
-		unsigned int Address = 0;
-		unsigned int Parent = 0;
+		unsigned int Parent = TNoIndex;
 		unsigned int NodeType = TNode<Type>::TNODE;
 
-		fread(Address, sizeof(unsigned int), 1, File);
-		fread(NodeType, sizeof(unsigned int), 1, File);
+		fread(&NodeType, sizeof(unsigned int), 1, File);
 		
 		char Name[255];
 		fread(Name, sizeof(char), 255, File);
+		Name[254] = '\0';
 
 		fread(&Parent, sizeof(unsigned int), 1, File);
 
-		Type LocalTransform[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
-		Type GlobalTransform[16] = LocalTransform;
+		Type LocalTransform[16];
+		Type GlobalTransform[16];
 
 		fread(LocalTransform, sizeof(Type), 16, File);
 		fread(GlobalTransform, sizeof(Type), 16, File);
@@ -2116,16 +3805,10 @@ struct TScene
 
 		switch (NodeType)
 		{
-		case TNode<Type>::TNODE:
-		{
-			TinyNode = new TNode<Type>();
-			break;
-		}
-
 		case TNode<Type>::TMESH:
 		{
 			TinyNode = new TMeshNode<Type>();
-			LoadMeshData((TMeshNode<Type>*)TinyNode, MaterialMap, File);
+			LoadMeshData((TMeshNode<Type>*)TinyNode, MaterialList, File);
 			break;
 		}
 
@@ -2145,41 +3828,47 @@ struct TScene
 
 		default:
 		{
+			TinyNode = new TNode<Type>();
 			break;
 		}
 		}
 
-		TinyNode->LocalTransform = LocalTransform;
-		TinyNode->GlobalTransform = GlobalTransform;
-		Nodes[Address] = TinyNode;
-
-		TinyNode->Parent = (TNode<Type>*)Parent;
+		memcpy(TinyNode->LocalTransform, LocalTransform, sizeof(Type) * 16);
+		memcpy(TinyNode->GlobalTransform, GlobalTransform, sizeof(Type) * 16);
+		strncpy(TinyNode->Name, Name, 255);
 
-		if (Root == nullptr)
+		if (Parent < Nodes.size())
+		{
+			TinyNode->Parent = Nodes[Parent];
+			Nodes[Parent]->Children.push_back(TinyNode);
+		}
+		else if (Root == nullptr)
 		{
 			Root = TinyNode;
 		}
-		
-		TinyNode->NodeType = NodeType;
-		strncpy(TinyNode->Name, Name, 255);
+		else
+		{
+			TinyNode->Parent = Root;
+			Root->Children.push_back(TinyNode);
+		}
 
-		switch (NodeType)
+		switch (TinyNode->NodeType)
 		{
 		case TNode<Type>::TMESH:
 		{
-			Meshes[TinyNode->Name] = (TMeshNode<Type>*)TinyNode;
+			Meshes.Add(TinyNode->Name, (TMeshNode<Type>*)TinyNode);
 			break;
 		}
 
 		case TNode<Type>::TLIGHT:
 		{
-			Lights[TinyNode->Name] = (TLightNode<Type>*)TinyNode;
+			Lights.Add(TinyNode->Name, (TLightNode<Type>*)TinyNode);
 			break;
 		}
 
 		case TNode<Type>::TCAMERA:
 		{
-			Cameras[TinyNode->Name] = (TCameraNode<Type>*)TinyNode;
+			Cameras.Add(TinyNode->Name, (TCameraNode<Type>*)TinyNode);
 			break;
 		}
 
@@ -2189,68 +3878,82 @@ struct TScene
 		}
 		}
 
-		unsigned int ChildCount = 0;
-		fread(&ChildCount, sizeof(unsigned int), 1, File);
-
-		unsigned int ChildIter = 0;
+		return TinyNode;
+	}
 
-		for (ChildIter = 0; ChildIter < ChildCount; ChildIter++)
+	void LoadMeshData(TMeshNode<Type>* Mesh, const std::vector<TMaterial<Type>*>& MaterialList, FILE* File)
+	{
+		unsigned int Material = TNoIndex;
+		fread(&Material, sizeof(unsigned int), 1, File);
+		Mesh->Material = (Material < MaterialList.size()) ? MaterialList[Material] : nullptr;
+
+		ReadVertices(Mesh->Vertices, File);
+		ReadIndices(Mesh->Indices, File);
+
+		unsigned int Skin[3] = { 0, 0, 0 };
+		fread(Skin, sizeof(unsigned int), 3, File);
+		Mesh->SkinInfluences = Skin[0];
+		Mesh->SkinIndexBytes = Skin[1];
+		Mesh->SkinWeightBytes = Skin[2];
+		ReadArray(Mesh->SkinIndices, File);
+		ReadArray(Mesh->SkinWeights, File);
+
+		ReadArray(Mesh->LODErrors, File);
+		Mesh->LODIndices.resize(Mesh->LODErrors.size());
+		for (unsigned int LODIter = 0; LODIter < Mesh->LODErrors.size(); LODIter++)
 		{
-			fread(&Address, sizeof(unsigned int), 1, File);
-			TinyNode->Children.push_back((TNode<Type>*)Address);
+			ReadIndices(Mesh->LODIndices[LODIter], File);
 		}
 
-		for (ChildIter = 0; ChildIter < ChildCount; ChildIter++)
-		{
-			LoadNode(Nodes, MaterialMap, File);
-		}
-	}
+		fread(Mesh->BoundsMin, sizeof(Type), 3, File);
+		fread(Mesh->BoundsMax, sizeof(Type), 3, File);
+		fread(Mesh->BoundsCenter, sizeof(Type), 3, File);
+		fread(&Mesh->BoundsRadius, sizeof(Type), 1, File);
 
-	void LoadMeshData(TMeshNode<Type>* Mesh, std::map<unsigned int, TMaterial<Type>*> MaterialMap, FILE* File)
-	{
-		unsigned int Address = 0;
-		fread(&Address, sizeof(unsigned int), 1, File);
-		Mesh->Material = MaterialMap[Address];
+		ReadArray(Mesh->Meshlets, File);
+		ReadArray(Mesh->MeshletVertices, File);
+		ReadArray(Mesh->MeshletTriangles, File);
 
-		unsigned int VertexCount = 0;
-		fread(&VertexCount, sizeof(unsigned int), 1, File);
+		ReadArray(Mesh->BVH.Nodes, File);
+		ReadArray(Mesh->BVH.Triangles, File);
+		ReadArray(Mesh->BVH.Positions, File);
 
-		if (VertexCount > 0)
+		ReadArray(Mesh->StreamLayouts, File);
+		Mesh->Streams.resize(Mesh->StreamLayouts.size());
+		for (unsigned int StreamIter = 0; StreamIter < Mesh->Streams.size(); StreamIter++)
 		{
-			TVertex<Type>* Vertices = new TVertex<Type>[VertexCount];
-			fread(Vertices, sizeof(TVertex<Type>), VertexCount, File);
-			for (unsigned int VertexIter = 0; VertexIter < VertexCount; VertexIter++)
-			{
-				Mesh->Vertices.push_back(Vertices[VertexIter]);
-			}
-			delete[] Vertices;
+			ReadVertices(Mesh->Streams[StreamIter], File);
 		}
 
-		unsigned int IndexCount = 0;
-		fread(&IndexCount, sizeof(unsigned int), 1, File);
-
-		if (IndexCount > 0)
+		ReadIndices(Mesh->ShortIndices, File);
+		ReadArray(Mesh->SubMeshes, File);
+		unsigned int ShortLODCount = 0;
+		fread(&ShortLODCount, sizeof(unsigned int), 1, File);
+		if (!FitsInFile(File, ShortLODCount, sizeof(unsigned int) * 2))
 		{
-			unsigned int* Indices = new unsigned int[IndexCount];
-			fread(Indices, sizeof(unsigned int), IndexCount, File);
-			for (unsigned int IndexIter = 0; IndexIter < IndexIter; IndexIter++)
-			{
-				Mesh->Indices.push_back(Indices[IndexIter]);
-			}
-			delete[] Indices;
+			ShortLODCount = 0;
+		}
+		Mesh->ShortLODIndices.resize(ShortLODCount);
+		for (unsigned int LODIter = 0; LODIter < ShortLODCount; LODIter++)
+		{
+			ReadIndices(Mesh->ShortLODIndices[LODIter], File);
 		}
 
+		if (ShortLODCount > 0)
+		{
+			Mesh->LODIndices.clear();
+		}
 	}
 
 	void LoadLightData(TLightNode<Type>* Light, FILE* File)
 	{
 		unsigned int Value = 0;
 		fread(&Value, sizeof(unsigned int), 1, File);
-		Light->LightType = Value;
+		Light->LightType = (typename TLightNode<Type>::TLightType)Value;
 
 		Value = 0;
 		fread(&Value, sizeof(unsigned int), 1, File);
-		Light->LightType = Value != 0;
+		Light->On = Value != 0;
 
 		fread(&Light->Color, sizeof(Type), 4, File);
 
@@ -2270,23 +3973,49 @@ struct TScene
 		fread(&Camera->ViewMatrix, sizeof(Type), 16, File);
 	}
 
-	void ReLink(TNode<Type>* Node, std::map<unsigned int, TNode<Type>*>& Nodes)
+	void LoadTrackData(TTrack<Type>& Track, FILE* File)
 	{
-		if (Node->Parent != nullptr)
-		{
-			Node->Parent = Nodes[(unsigned int)Node->Parent];
-		}
-		unsigned int ChildCount = Node->Children.size();
-		for (unsigned int ChildIter = 0; ChildIter < ChildCount; ChildIter++)
+		unsigned int Info[3] = { 0, 0, 0 };
+		fread(Info, sizeof(unsigned int), 3, File);
+		Track.BoneIndex = Info[0];
+		Track.KeyFrameCount = Info[1];
+
+		if (Info[2] == 0)
 		{
-			Node->Children[ChildIter] = Nodes[(unsigned int)Node->Children[ChildIter]];
-			ReLink(Node->Children[ChildIter], Nodes);
+			if (!FitsInFile(File, Track.KeyFrameCount, sizeof(TKeyFrame<Type>)))
+			{
+				Track.KeyFrameCount = 0;
+			}
+			Track.KeyFrames = new TKeyFrame<Type>[Track.KeyFrameCount];
+			fread(Track.KeyFrames, sizeof(TKeyFrame<Type>), Track.KeyFrameCount, File);
+			return;
 		}
+
+		TCompressedTrack<Type>* Packed = new TCompressedTrack<Type>();
+		fread(Packed->TranslationMin, sizeof(Type), 3, File);
+		fread(Packed->TranslationRange, sizeof(Type), 3, File);
+		fread(Packed->ScaleMin, sizeof(Type), 3, File);
+		fread(Packed->ScaleRange, sizeof(Type), 3, File);
+
+		ReadArray(Packed->BlockKeys, File);
+		ReadArray(Packed->KeyDeltas, File);
+		ReadArray(Packed->Rotations, File);
+		ReadArray(Packed->Translations, File);
+		ReadArray(Packed->Scales, File);
+		Track.Compressed = Packed;
 	}
 
+	struct TPendingMesh
+	{
+		TPendingMesh(TMeshNode<Type>* Mesh, FbxNode* FBXNode) : Mesh(Mesh), FBXNode(FBXNode){}
+
+		TMeshNode<Type>* Mesh;
+		FbxNode* FBXNode;
+	};
+
 	struct ImportAssistor
 	{
-		ImportAssistor() : CurrentScene(nullptr), Evaluator(nullptr)
+		ImportAssistor() : CurrentScene(nullptr), Evaluator(nullptr), BoneCount(0)
 		{
 			//Evaluator = new FbxAnimEvaluator();
 		}
@@ -2300,7 +4029,12 @@ struct TScene
 		FbxAnimEvaluator* Evaluator;
 		std::vector<TNode<Type>*> Bones;
 
-		std::map<const char*, unsigned int> BoneIndexMap;
+		//bone name -> index into Bones, filled by CollectBones
+		TNameIndex BoneIndices;
+		unsigned int BoneCount;
+
+		//meshes found while walking the scene, extracted together afterwards
+		std::vector<TPendingMesh> PendingMeshes;
 	};
 
 	TNode<Type>* Root;
@@ -2308,15 +4042,89 @@ struct TScene
 	char* Path;
 	Type AmbientLight[4];
 
+	//corners closer than this are welded into one vertex. 0 welds exact matches only
+	Type WeldEpsilon;
+
+	//extract meshes as parallel tasks once the node tree is built
+	bool ParallelExtraction;
+	//worker threads used on import, 0 uses every core
+	unsigned int ThreadCount;
+
+	//strongest bones kept per vertex, up to 32. TVertex holds up to 4, the compact skin stream holds them all
+	unsigned int MaxInfluences;
+	//bytes per weight in the compact skin stream, 1 for unorm8 or 2 for unorm16
+	unsigned int SkinWeightBytes;
+
+	//frames per second animation keys are numbered at, 0 uses the scene's time mode
+	double AnimationFrameRate;
+
+	//run ReduceAnimations once a scene is imported
+	bool ReduceKeyFrames;
+	//largest error a dropped key may leave, rotation in radians
+	Type RotationTolerance;
+	Type TranslationTolerance;
+	Type ScaleTolerance;
+
+	//pack every track with TTrack::Compress once a scene is imported
+	bool CompressTracks;
+
+	//run OptimizeMesh on every mesh as it is imported
+	bool OptimizeVertexOrder;
+	//FIFO size the ACMR and ATVR figures are measured against
+	unsigned int VertexCacheSize;
+	//sort triangle clusters of unskinned meshes by occlusion in OptimizeMesh
+	bool ReduceOverdraw;
+	//ACMR the overdraw sort may grow to, as a multiple of the cache optimized ACMR
+	Type OverdrawThreshold;
+
+	//simplified index buffers GenerateLODs builds per mesh on import, 0 for none
+	unsigned int LODCount;
+	//triangle count of each LOD as a fraction of the one before
+	Type LODReduction;
+	//furthest any LOD may stray from the full mesh, relative to its largest extent
+	Type LODTargetError;
+
+	//run GenerateMeshlets on every mesh as it is imported
+	bool SplitMeshlets;
+	unsigned int MeshletMaxVertices;
+	unsigned int MeshletMaxTriangles;
+
+	//run GenerateBVH on every mesh as it is imported
+	bool BuildMeshBVHs;
+
+	//run SplitStreams on every mesh as the last import step, leaving Vertices empty
+	bool SplitVertexStreams;
+	//quantize the non position stream with TVertexLayout::Compress
+	bool CompressStreams;
+
+	//run NarrowIndices on every mesh as it is imported
+	bool NarrowIndexBuffers;
+	//let NarrowIndices cut meshes with too many vertices for 16 bit indices into SubMeshes
+	bool SplitLargeMeshes;
+
+	//store index buffers through EncodeIndexBuffer in SaveTinyModel, which
+	//works best on meshes run through OptimizeMesh
+	bool CompressIndices;
+	//store Vertices and each vertex stream through EncodeVertexBuffer in SaveTinyModel
+	bool CompressVertices;
+
 	ImportAssistor* Assistor;
 
-	std::map<const char*, TMeshNode<Type>*> Meshes;
-	std::map<const char*, TLightNode<Type>*> Lights;
-	std::map<const char*, TCameraNode<Type>*> Cameras;
-	std::map<const char*, TMaterial<Type>*> Materials;
-	std::map<const char*, TAnimation<Type>*> Animations;
+	TAssetTable<TMeshNode<Type>> Meshes;
+	TAssetTable<TLightNode<Type>> Lights;
+	TAssetTable<TCameraNode<Type>> Cameras;
+	TAssetTable<TMaterial<Type>> Materials;
+	TAssetTable<TAnimation<Type>> Animations;
 
 	std::vector<TSkeleton<Type>*> Skeletons;
+
+	//world boxes of Meshes in table order, refreshed by UpdateWorldBounds
+	TBoundsBatch<Type> MeshBounds;
+
+	//world boxes of every node, SceneBVHNodes in preorder maps its items back to nodes
+	TBoundsTree<Type> SceneBVH;
+	std::vector<TNode<Type>*> SceneBVHNodes;
+	std::map<const TNode<Type>*, unsigned int> SceneBVHIndices;
 };
 
 /*template<typename Type>